@@ -0,0 +1,186 @@
+#include "chip8c.h"
+
+#include <memory>
+#include <new>
+#include <string>
+
+#include "../core/chip8.h"
+#include "../core/rom.h"
+
+struct chip8c_machine {
+    Chip8 chip8;
+    Clock clock;
+    int cpu_hz;
+    double fps;
+    std::unique_ptr<Rom> rom;  // Reloaded on reset
+    std::string error;
+
+    // The framebuffer after the previous step, to tell whether a step changed it
+    Display shown;
+    bool changed = false;
+
+    chip8c_machine(int cpu_hz, double fps) : clock(cpu_hz, fps), cpu_hz(cpu_hz), fps(fps) {
+        chip8.reset();
+    }
+
+    // Notes whether the framebuffer changed since the previous call.
+    void compare() {
+        auto& display = chip8.get_display();
+        changed = display != shown;
+        if (changed) {
+            shown = display;
+        }
+    }
+
+    // Restarts the loaded rom, with a clock that starts a new frame.
+    void restart() {
+        chip8.reset();
+        if (rom) {
+            chip8.load_rom(*rom);
+        }
+        clock = Clock(cpu_hz, fps);
+    }
+
+    int fail(const std::exception& e) {
+        error = e.what();
+        while (!error.empty() && error.back() == '\n') {
+            error.pop_back();
+        }
+        return -1;
+    }
+};
+
+int chip8c_version(void) {
+    return CHIP8C_VERSION;
+}
+
+chip8c_machine* chip8c_create(int cpu_hz, double fps) {
+    if (cpu_hz <= 0 || !(fps > 0)) {
+        return nullptr;
+    }
+    return new (std::nothrow) chip8c_machine(cpu_hz, fps);
+}
+
+void chip8c_destroy(chip8c_machine* machine) {
+    delete machine;
+}
+
+const char* chip8c_last_error(const chip8c_machine* machine) {
+    return machine->error.c_str();
+}
+
+int chip8c_set_variant(chip8c_machine* machine, int variant) {
+    if (variant < CHIP8C_CHIP8 || variant > CHIP8C_XOCHIP) {
+        machine->error = "Unknown variant";
+        return -1;
+    }
+    machine->chip8.set_variant(static_cast<Variant>(variant));
+    return 0;
+}
+
+int chip8c_set_engine(chip8c_machine* machine, int engine) {
+    switch (engine) {
+        case CHIP8C_INTERPRETER:
+            machine->chip8.set_execution_mode(ExecutionMode::Interpreter);
+            return 0;
+        case CHIP8C_BLOCKS:
+            machine->chip8.set_execution_mode(ExecutionMode::Blocks);
+            return 0;
+        case CHIP8C_JIT:
+            machine->chip8.set_execution_mode(ExecutionMode::Jit);
+            return 0;
+        case CHIP8C_STATIC:
+            machine->chip8.set_execution_mode(ExecutionMode::Static);
+            return 0;
+        default:
+            machine->error = "Unknown execution engine";
+            return -1;
+    }
+}
+
+void chip8c_seed(chip8c_machine* machine, uint64_t seed) {
+    machine->chip8.seed(seed);
+}
+
+int chip8c_load(chip8c_machine* machine, const uint8_t* data, size_t size) {
+    try {
+        auto rom = std::make_unique<Rom>(data, size);
+        machine->chip8.reset();
+        machine->chip8.load_rom(*rom);
+        machine->rom = std::move(rom);
+        machine->clock = Clock(machine->cpu_hz, machine->fps);
+    } catch (const std::exception& e) {
+        // A rom that does not fit leaves the machine cleared
+        machine->rom.reset();
+        machine->compare();
+        return machine->fail(e);
+    }
+    machine->compare();
+    return 0;
+}
+
+void chip8c_reset(chip8c_machine* machine) {
+    machine->restart();
+    machine->compare();
+}
+
+// Execution only throws in builds with CHIP8_CHECKED_ACCESS.
+int chip8c_step_cycles(chip8c_machine* machine, int cycles) {
+    try {
+        machine->chip8.run(cycles);
+    } catch (const std::exception& e) {
+        machine->compare();
+        return machine->fail(e);
+    }
+    machine->compare();
+    return 0;
+}
+
+int chip8c_step_frame(chip8c_machine* machine, int frames) {
+    try {
+        for (auto i = 0; i < frames; i++) {
+            machine->chip8.run_frame(machine->clock.next_frame());
+        }
+    } catch (const std::exception& e) {
+        machine->compare();
+        return machine->fail(e);
+    }
+    machine->compare();
+    return 0;
+}
+
+int chip8c_step(chip8c_machine* const* machines, size_t count, int frames) {
+    auto result = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (chip8c_step_frame(machines[i], frames) != 0) {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+void chip8c_set_keys(chip8c_machine* machine, uint16_t keys) {
+    for (auto key = 0; key < 0x10; key++) {
+        machine->chip8.set_key(key, (keys >> key) & 1);
+    }
+}
+
+const uint64_t* chip8c_framebuffer(const chip8c_machine* machine) {
+    return machine->chip8.get_display().words();
+}
+
+int chip8c_hires(const chip8c_machine* machine) {
+    return machine->chip8.get_display().is_hires();
+}
+
+int chip8c_frame_changed(const chip8c_machine* machine) {
+    return machine->changed;
+}
+
+int chip8c_sound_on(const chip8c_machine* machine) {
+    return machine->chip8.sound_on();
+}
+
+uint64_t chip8c_cycles(const chip8c_machine* machine) {
+    return machine->chip8.get_cycles();
+}
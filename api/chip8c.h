@@ -0,0 +1,113 @@
+#ifndef CHIP8C_H
+#define CHIP8C_H
+
+// C interface to the emulator core for embedding it into other languages. The functions never
+// throw; failures are reported by the return value and chip8c_last_error.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(CHIP8C_BUILD)
+#define CHIP8C_API __declspec(dllexport)
+#else
+#define CHIP8C_API __declspec(dllimport)
+#endif
+#else
+#define CHIP8C_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Incremented whenever a function or type changes incompatibly
+#define CHIP8C_VERSION 1
+
+// Framebuffer layout, see chip8c_framebuffer
+#define CHIP8C_WIDTH 128
+#define CHIP8C_HEIGHT 64
+#define CHIP8C_PLANES 2
+#define CHIP8C_ROW_WORDS 2
+
+typedef enum chip8c_variant {
+    CHIP8C_CHIP8 = 0,
+    CHIP8C_SUPERCHIP = 1,
+    CHIP8C_XOCHIP = 2,
+} chip8c_variant;
+
+typedef enum chip8c_engine {
+    CHIP8C_INTERPRETER = 0,
+    CHIP8C_BLOCKS = 1,
+    CHIP8C_JIT = 2,
+    CHIP8C_STATIC = 3,
+} chip8c_engine;
+
+// An emulated machine with its clock. Machines are independent of each other, but a single
+// machine must not be used from two threads at once.
+typedef struct chip8c_machine chip8c_machine;
+
+// Returns CHIP8C_VERSION of the library, to check it against the header at runtime.
+CHIP8C_API int chip8c_version(void);
+
+// Creates a machine that runs cpu_hz instructions per second in frames of 1 / fps seconds.
+// Returns NULL if the rates are not positive or memory runs out.
+CHIP8C_API chip8c_machine* chip8c_create(int cpu_hz, double fps);
+CHIP8C_API void chip8c_destroy(chip8c_machine* machine);
+
+// Returns the message of the last failed call on the machine, or an empty string.
+CHIP8C_API const char* chip8c_last_error(const chip8c_machine* machine);
+
+// Selects the machine to emulate and how instructions run. The variant takes full effect with
+// the next load or reset. Return 0, or -1 for an unknown value.
+CHIP8C_API int chip8c_set_variant(chip8c_machine* machine, int variant);
+CHIP8C_API int chip8c_set_engine(chip8c_machine* machine, int engine);
+
+// Seeds the random number generator. The seed is kept across resets.
+CHIP8C_API void chip8c_seed(chip8c_machine* machine, uint64_t seed);
+
+// Resets the machine and loads a rom image from a buffer, which is copied. Returns 0, or -1 if
+// the image does not fit into memory.
+CHIP8C_API int chip8c_load(chip8c_machine* machine, const uint8_t* data, size_t size);
+
+// Restarts the loaded rom from a cleared machine.
+CHIP8C_API void chip8c_reset(chip8c_machine* machine);
+
+// Runs the given number of instructions without advancing the timers. Returns 0, or -1 if the
+// rom accessed memory out of range in a build with CHIP8_CHECKED_ACCESS.
+CHIP8C_API int chip8c_step_cycles(chip8c_machine* machine, int cycles);
+
+// Runs the given number of frames, with the instructions and timer ticks that fall into them.
+// Returns like chip8c_step_cycles.
+CHIP8C_API int chip8c_step_frame(chip8c_machine* machine, int frames);
+
+// Runs the given number of frames on each of count machines, one after another. Returns 0, or
+// -1 if any of them failed.
+CHIP8C_API int chip8c_step(chip8c_machine* const* machines, size_t count, int frames);
+
+// Sets the pressed keys, key 0 in the lowest bit.
+CHIP8C_API void chip8c_set_keys(chip8c_machine* machine, uint16_t keys);
+
+// Returns the framebuffer, which stays valid and changes in place while the machine exists.
+// There are CHIP8C_PLANES planes of CHIP8C_HEIGHT rows. Each row has CHIP8C_ROW_WORDS words
+// of 64 pixels, the leftmost pixel in the most significant bit. In lo-res mode only the first
+// word of the first 32 rows is used.
+CHIP8C_API const uint64_t* chip8c_framebuffer(const chip8c_machine* machine);
+
+// Returns whether the machine is in 128x64 hi-res mode.
+CHIP8C_API int chip8c_hires(const chip8c_machine* machine);
+
+// Returns whether the framebuffer changed during the last step, load or reset.
+CHIP8C_API int chip8c_frame_changed(const chip8c_machine* machine);
+
+// Returns whether the beeper sounds.
+CHIP8C_API int chip8c_sound_on(const chip8c_machine* machine);
+
+// Returns the number of instructions run since the last load or reset.
+CHIP8C_API uint64_t chip8c_cycles(const chip8c_machine* machine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
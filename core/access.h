@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+
+// Policies for indexing guest state with values that come from the running program.
+//
+// Checked throws std::out_of_range on an index past the end, which helps when debugging a
+// rom. Wrapped masks the index to the size of the array without a branch, so execution never
+// throws. Both behave the same for indices in range. Wrapped is the default unless the core
+// is built with CHIP8_CHECKED_ACCESS.
+struct Checked {
+    template <std::size_t N>
+    static std::size_t index(std::size_t index) {
+        if (index >= N) {
+            throw std::out_of_range("Index out of range");
+        }
+        return index;
+    }
+
+    template <typename T, std::size_t N>
+    static T& at(std::array<T, N>& array, std::size_t index) {
+        return array.at(index);
+    }
+
+    template <typename T, std::size_t N>
+    static const T& at(const std::array<T, N>& array, std::size_t index) {
+        return array.at(index);
+    }
+};
+
+struct Wrapped {
+    template <std::size_t N>
+    static std::size_t index(std::size_t index) {
+        static_assert((N & (N - 1)) == 0, "Wrapped access needs a power of two size");
+        return index & (N - 1);
+    }
+
+    template <typename T, std::size_t N>
+    static T& at(std::array<T, N>& array, std::size_t index) {
+        static_assert((N & (N - 1)) == 0, "Wrapped access needs a power of two size");
+        return array[index & (N - 1)];
+    }
+
+    template <typename T, std::size_t N>
+    static const T& at(const std::array<T, N>& array, std::size_t index) {
+        static_assert((N & (N - 1)) == 0, "Wrapped access needs a power of two size");
+        return array[index & (N - 1)];
+    }
+};
+
+#ifdef CHIP8_CHECKED_ACCESS
+using DefaultAccess = Checked;
+#else
+using DefaultAccess = Wrapped;
+#endif
@@ -0,0 +1,550 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "chip8.h"
+#include "idle.h"
+#include "random.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace simd {
+
+// Byte-wise operations on as many lanes as the host vectors hold. The flag operations return
+// 1 in every byte where the condition holds and 0 elsewhere.
+#if defined(__AVX2__)
+using Vec = __m256i;
+constexpr int width = 32;
+
+inline Vec load(const uint8_t* p) { return _mm256_loadu_si256(reinterpret_cast<const Vec*>(p)); }
+inline void store(uint8_t* p, Vec v) { _mm256_storeu_si256(reinterpret_cast<Vec*>(p), v); }
+inline Vec set(uint8_t v) { return _mm256_set1_epi8(static_cast<char>(v)); }
+inline Vec add(Vec a, Vec b) { return _mm256_add_epi8(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm256_sub_epi8(a, b); }
+inline Vec bit_or(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+inline Vec bit_and(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+inline Vec bit_xor(Vec a, Vec b) { return _mm256_xor_si256(a, b); }
+inline Vec carry(Vec a, Vec b) { return _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_adds_epu8(a, b), add(a, b)), set(1)); }
+inline Vec greater(Vec a, Vec b) {
+    auto ge = _mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a);
+    return _mm256_and_si256(_mm256_andnot_si256(_mm256_cmpeq_epi8(a, b), ge), set(1));
+}
+inline Vec shr1(Vec a) { return _mm256_and_si256(_mm256_srli_epi16(a, 1), set(0x7F)); }
+inline Vec msb(Vec a) { return _mm256_and_si256(_mm256_srli_epi16(a, 7), set(1)); }
+#elif defined(__SSE2__)
+using Vec = __m128i;
+constexpr int width = 16;
+
+inline Vec load(const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const Vec*>(p)); }
+inline void store(uint8_t* p, Vec v) { _mm_storeu_si128(reinterpret_cast<Vec*>(p), v); }
+inline Vec set(uint8_t v) { return _mm_set1_epi8(static_cast<char>(v)); }
+inline Vec add(Vec a, Vec b) { return _mm_add_epi8(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm_sub_epi8(a, b); }
+inline Vec bit_or(Vec a, Vec b) { return _mm_or_si128(a, b); }
+inline Vec bit_and(Vec a, Vec b) { return _mm_and_si128(a, b); }
+inline Vec bit_xor(Vec a, Vec b) { return _mm_xor_si128(a, b); }
+inline Vec carry(Vec a, Vec b) { return _mm_andnot_si128(_mm_cmpeq_epi8(_mm_adds_epu8(a, b), add(a, b)), set(1)); }
+inline Vec greater(Vec a, Vec b) {
+    auto ge = _mm_cmpeq_epi8(_mm_max_epu8(a, b), a);
+    return _mm_and_si128(_mm_andnot_si128(_mm_cmpeq_epi8(a, b), ge), set(1));
+}
+inline Vec shr1(Vec a) { return _mm_and_si128(_mm_srli_epi16(a, 1), set(0x7F)); }
+inline Vec msb(Vec a) { return _mm_and_si128(_mm_srli_epi16(a, 7), set(1)); }
+#else
+using Vec = uint8_t;
+constexpr int width = 1;
+
+inline Vec load(const uint8_t* p) { return *p; }
+inline void store(uint8_t* p, Vec v) { *p = v; }
+inline Vec set(uint8_t v) { return v; }
+inline Vec add(Vec a, Vec b) { return a + b; }
+inline Vec sub(Vec a, Vec b) { return a - b; }
+inline Vec bit_or(Vec a, Vec b) { return a | b; }
+inline Vec bit_and(Vec a, Vec b) { return a & b; }
+inline Vec bit_xor(Vec a, Vec b) { return a ^ b; }
+inline Vec carry(Vec a, Vec b) { return (unsigned)a + (unsigned)b > 0xFF; }
+inline Vec greater(Vec a, Vec b) { return a > b; }
+inline Vec shr1(Vec a) { return a >> 1; }
+inline Vec msb(Vec a) { return a >> 7; }
+#endif
+
+}  // namespace simd
+
+Batch::Batch(int size) : count(size), lanes((size + simd::width - 1) / simd::width * simd::width) {
+    for (auto& reg : regs) {
+        reg.resize(lanes);
+    }
+    I.resize(count);
+    pc.resize(count);
+    sp.resize(count);
+    delay_timer.resize(count);
+    sound_timer.resize(count);
+    rng.resize(count);
+    seeds.resize(count, prng::default_seed);
+    stack.resize(count);
+    memory.resize(count);
+    display.resize(count);
+    keypad.resize(count);
+    reset();
+}
+
+// Resets every lane to the initial state of a Chip8.
+void Batch::reset() {
+    for (auto& reg : regs) {
+        std::fill(reg.begin(), reg.end(), 0);
+    }
+    std::fill(I.begin(), I.end(), 0);
+    std::fill(pc.begin(), pc.end(), Memory::offset);
+    std::fill(sp.begin(), sp.end(), 0);
+    std::fill(delay_timer.begin(), delay_timer.end(), 0);
+    std::fill(sound_timer.begin(), sound_timer.end(), 0);
+    std::copy(seeds.begin(), seeds.end(), rng.begin());
+
+    for (auto lane = 0; lane < count; lane++) {
+        stack[lane] = {0};
+        memory[lane].reset();
+        display[lane].reset();
+        keypad[lane].reset();
+    }
+
+    written.reset();
+    icache.fill({});
+}
+
+// Loads the same rom into every lane.
+void Batch::load_rom(std::string filename) {
+    load_rom(Rom::from_file(filename));
+}
+
+void Batch::load_rom(const Rom& rom) {
+    for (auto& lane : memory) {
+        lane.load_rom(rom);
+    }
+    written.reset();
+    icache.fill({});
+}
+
+// Runs one frame of emulated time on every lane, see Chip8::run_frame.
+void Batch::run_frame(Clock::Frame frame) {
+    for (auto i = 0; i < frame.timer_ticks; i++) {
+        for (auto lane = 0; lane < count; lane++) {
+            delay_timer[lane] -= delay_timer[lane] > 0;
+            sound_timer[lane] -= sound_timer[lane] > 0;
+        }
+    }
+    run(frame.cycles);
+}
+
+// Skips whole iterations while every lane waits, see Chip8::run.
+void Batch::run(int cycles) {
+    if (wait_period > 0) {
+        unchecked = idle_check_interval - wait_period;
+    }
+    while (cycles > 0) {
+        if (unchecked >= idle_check_interval) {
+            wait_period = waiting();
+            unchecked = 0;
+            if (wait_period > 0) {
+                cycles %= wait_period;
+            }
+        }
+        auto slice = std::min(cycles, idle_check_interval - unchecked);
+        for (auto i = 0; i < slice; i++) {
+            tick();
+        }
+        unchecked += slice;
+        cycles -= slice;
+    }
+}
+
+// Returns the number of ticks after which every lane is back where it started in its wait
+// loop, or 0 if any lane is not waiting.
+int Batch::waiting() const {
+    auto period = 1;
+    for (auto lane = 0; lane < count; lane++) {
+        auto& mem = memory[lane];
+        auto lane_period = wait_loop(
+            pc[lane], [&](int address) { return Chip8::decode(mem[address] << 8 | mem[address + 1]); },
+            [&](int x) { return regs[x][lane]; }, I[lane], delay_timer[lane], keypad[lane].state());
+        if (lane_period == 0) {
+            return 0;
+        }
+        period = std::lcm(period, lane_period);
+    }
+    return period;
+}
+
+// Runs one instruction on every lane. If all lanes are at the same instruction it is decoded
+// once and, where a kernel exists, executed for all lanes at once.
+void Batch::tick() {
+    Instruction scratch;
+
+    if (uniform_pc() && uniform_opcode(pc[0])) {
+        auto ins = fetch(0, scratch);
+        for (auto lane = 0; lane < count; lane++) {
+            pc[lane] += 2;
+        }
+        if (execute_all(ins)) {
+            return;
+        }
+        for (auto lane = 0; lane < count; lane++) {
+            execute(lane, ins);
+        }
+        return;
+    }
+
+    for (auto lane = 0; lane < count; lane++) {
+        auto ins = fetch(lane, scratch);
+        pc[lane] += 2;
+        execute(lane, ins);
+    }
+}
+
+void Batch::set_key(int lane, int key, int val) {
+    keypad.at(lane).set(key, val != 0);
+}
+
+void Batch::seed(int lane, uint64_t value) {
+    seeds.at(lane) = value;
+    rng[lane] = value;
+}
+
+const Display& Batch::get_display(int lane) const {
+    return display.at(lane);
+}
+
+bool Batch::uniform_pc() const {
+    auto first = pc[0];
+    for (auto lane = 1; lane < count; lane++) {
+        if (pc[lane] != first) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns whether every lane holds the same opcode at the given address.
+bool Batch::uniform_opcode(int address) const {
+    if (address + 1 >= static_cast<int>(icache.size())) {
+        return false;
+    }
+    if (!written[address] && !written[address + 1]) {
+        return true;
+    }
+    auto hi = memory[0][address];
+    auto lo = memory[0][address + 1];
+    for (auto lane = 1; lane < count; lane++) {
+        if (memory[lane][address] != hi || memory[lane][address + 1] != lo) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns the decoded instruction at the program counter of a lane. Instructions in memory
+// that no lane wrote to are shared and cached, others are decoded into the scratch space.
+const Instruction& Batch::fetch(int lane, Instruction& scratch) {
+    auto address = pc[lane];
+    if (address + 1 < static_cast<int>(icache.size()) && !written[address] && !written[address + 1]) {
+        auto& ins = icache[address];
+        if (ins.handler == nullptr) {
+            ins = Chip8::decode(memory[lane][address] << 8 | memory[lane][address + 1]);
+        }
+        return ins;
+    }
+    scratch = Chip8::decode(memory[lane][address & 0xFFF] << 8 | memory[lane][(address + 1) & 0xFFF]);
+    return scratch;
+}
+
+// Executes an instruction on all lanes at once. Flag instructions write VF before they read
+// Vx and Vy for the result, like the Chip8 handlers. Skips only move the program counters of
+// the lanes that skip. Returns false if the instruction has no kernel.
+bool Batch::execute_all(const Instruction& ins) {
+    using namespace simd;
+
+    auto vx = regs[ins.x].data();
+    auto vy = regs[ins.y].data();
+    auto vf = regs[0xF].data();
+
+    // Runs the kernel for every vector of lanes
+    auto each = [&](auto kernel) {
+        for (auto lane = 0; lane < lanes; lane += width) {
+            kernel(lane);
+        }
+    };
+
+    switch (ins.op) {
+        case Op::nop:
+            return true;
+        case Op::cls:
+            for (auto& screen : display) {
+                screen.clear();
+            }
+            return true;
+        case Op::jmp:
+            std::fill(pc.begin(), pc.end(), ins.nnn);
+            return true;
+        case Op::se_byte:
+            for (auto lane = 0; lane < count; lane++) {
+                pc[lane] += (vx[lane] == ins.kk) << 1;
+            }
+            return true;
+        case Op::sne_byte:
+            for (auto lane = 0; lane < count; lane++) {
+                pc[lane] += (vx[lane] != ins.kk) << 1;
+            }
+            return true;
+        case Op::se_reg:
+            for (auto lane = 0; lane < count; lane++) {
+                pc[lane] += (vx[lane] == vy[lane]) << 1;
+            }
+            return true;
+        case Op::sne:
+            for (auto lane = 0; lane < count; lane++) {
+                pc[lane] += (vx[lane] != vy[lane]) << 1;
+            }
+            return true;
+        case Op::ld_byte:
+            std::fill(regs[ins.x].begin(), regs[ins.x].end(), ins.kk);
+            return true;
+        case Op::add_byte:
+            each([&](int l) { store(vx + l, add(load(vx + l), set(ins.kk))); });
+            return true;
+        case Op::ld_reg:
+            each([&](int l) { store(vx + l, load(vy + l)); });
+            return true;
+        case Op::fn_or:
+            each([&](int l) { store(vx + l, bit_or(load(vx + l), load(vy + l))); });
+            return true;
+        case Op::fn_and:
+            each([&](int l) { store(vx + l, bit_and(load(vx + l), load(vy + l))); });
+            return true;
+        case Op::fn_xor:
+            each([&](int l) { store(vx + l, bit_xor(load(vx + l), load(vy + l))); });
+            return true;
+        case Op::add_reg:
+            each([&](int l) {
+                store(vf + l, carry(load(vx + l), load(vy + l)));
+                store(vx + l, add(load(vx + l), load(vy + l)));
+            });
+            return true;
+        case Op::sub:
+            each([&](int l) {
+                store(vf + l, greater(load(vx + l), load(vy + l)));
+                store(vx + l, sub(load(vx + l), load(vy + l)));
+            });
+            return true;
+        case Op::subn:
+            each([&](int l) {
+                store(vf + l, greater(load(vy + l), load(vx + l)));
+                store(vx + l, sub(load(vy + l), load(vx + l)));
+            });
+            return true;
+        case Op::shr:
+            each([&](int l) {
+                store(vf + l, bit_and(load(vx + l), set(1)));
+                store(vx + l, shr1(load(vx + l)));
+            });
+            return true;
+        case Op::shl:
+            each([&](int l) {
+                store(vf + l, msb(load(vx + l)));
+                auto value = load(vx + l);
+                store(vx + l, add(value, value));
+            });
+            return true;
+        case Op::ld:
+            std::fill(I.begin(), I.end(), ins.nnn);
+            return true;
+        case Op::add_i_reg:
+            for (auto lane = 0; lane < count; lane++) {
+                I[lane] += vx[lane];
+            }
+            return true;
+        case Op::set_i_reg:
+            for (auto lane = 0; lane < count; lane++) {
+                I[lane] = vx[lane] * 5;
+            }
+            return true;
+        case Op::ld_delay_timer:
+            std::copy(delay_timer.begin(), delay_timer.end(), vx);
+            return true;
+        case Op::ld_delay_timer_set:
+            std::copy(vx, vx + count, delay_timer.begin());
+            return true;
+        case Op::ld_sound_timer_set:
+            std::copy(vx, vx + count, sound_timer.begin());
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Executes an instruction on a single lane, with the semantics of the Chip8 handlers.
+void Batch::execute(int lane, const Instruction& ins) {
+    auto V = [&](int x) -> uint8_t& { return regs[x][lane]; };
+    auto x = ins.x;
+    auto y = ins.y;
+    auto kk = ins.kk;
+    auto& pc = this->pc[lane];
+    auto& sp = this->sp[lane];
+    auto& I = this->I[lane];
+
+    switch (ins.op) {
+        case Op::nop:
+        case Op::exit:
+            break;
+        case Op::cls:
+            display[lane].clear();
+            break;
+        case Op::ret:
+            pc = DefaultAccess::at(stack[lane], --sp);
+            break;
+        case Op::jmp:
+            pc = ins.nnn;
+            break;
+        case Op::call:
+            DefaultAccess::at(stack[lane], sp++) = pc;
+            pc = ins.nnn;
+            break;
+        case Op::se_byte:
+            if (V(x) == kk) {
+                pc += 2;
+            }
+            break;
+        case Op::sne_byte:
+            if (V(x) != kk) {
+                pc += 2;
+            }
+            break;
+        case Op::se_reg:
+            if (V(x) == V(y)) {
+                pc += 2;
+            }
+            break;
+        case Op::ld_byte:
+            V(x) = kk;
+            break;
+        case Op::add_byte:
+            V(x) += kk;
+            break;
+        case Op::ld_reg:
+            V(x) = V(y);
+            break;
+        case Op::fn_or:
+            V(x) |= V(y);
+            break;
+        case Op::fn_and:
+            V(x) &= V(y);
+            break;
+        case Op::fn_xor:
+            V(x) ^= V(y);
+            break;
+        case Op::add_reg:
+            V(0xF) = ((unsigned)V(x) + (unsigned)V(y) > 0xFF) ? 1 : 0;
+            V(x) += V(y);
+            break;
+        case Op::sub:
+            V(0xF) = (V(x) > V(y)) ? 1 : 0;
+            V(x) -= V(y);
+            break;
+        case Op::shr:
+            V(0xF) = V(x) & 1;
+            V(x) >>= 1;
+            break;
+        case Op::subn:
+            V(0xF) = (V(y) > V(x)) ? 1 : 0;
+            V(x) = V(y) - V(x);
+            break;
+        case Op::shl:
+            V(0xF) = (V(x) >> 7) & 0x1;
+            V(x) <<= 1;
+            break;
+        case Op::sne:
+            if (V(x) != V(y)) {
+                pc += 2;
+            }
+            break;
+        case Op::ld:
+            I = ins.nnn;
+            break;
+        case Op::jp_reg:
+            pc = ins.nnn + V(0);
+            break;
+        case Op::rnd:
+            V(x) = prng::next(rng[lane]) & kk;
+            break;
+        case Op::drw: {
+            V(0xF) = 0;
+            auto px = V(x);
+            auto py = V(y);
+            for (auto row = 0; row < ins.n; row++) {
+                if (display[lane].draw(px, py + row, memory[lane][(I + row) & 0xFFF])) {
+                    V(0xF) = 1;
+                }
+            }
+            break;
+        }
+        case Op::skp:
+            if (keypad[lane].is_pressed(V(x)) == 1) {
+                pc += 2;
+            }
+            break;
+        case Op::sknp:
+            if (keypad[lane].is_pressed(V(x)) == 0) {
+                pc += 2;
+            }
+            break;
+        case Op::ld_delay_timer:
+            V(x) = delay_timer[lane];
+            break;
+        case Op::ld_timer_wait: {
+            auto key = keypad[lane].highest_pressed(0x7FFF);
+            if (key >= 0) {
+                V(x) = key;
+            } else {
+                pc -= 2;
+            }
+            break;
+        }
+        case Op::ld_delay_timer_set:
+            delay_timer[lane] = V(x);
+            break;
+        case Op::ld_sound_timer_set:
+            sound_timer[lane] = V(x);
+            break;
+        case Op::add_i_reg:
+            I += V(x);
+            break;
+        case Op::set_i_reg:
+            I = V(x) * 5;
+            break;
+        case Op::bcd:
+            write_memory(lane, (I + 0) & 0xFFF, (V(x) % 1000) / 100);
+            write_memory(lane, (I + 1) & 0xFFF, (V(x) % 100) / 10);
+            write_memory(lane, (I + 2) & 0xFFF, V(x) % 10);
+            break;
+        case Op::cpy_regs_to_mem:
+            for (auto index = 0; index < x; index++) {
+                write_memory(lane, I++ & 0xFFF, V(index));
+            }
+            break;
+        case Op::cpy_mem_to_regs:
+            for (auto index = 0; index < x; index++) {
+                V(index) = memory[lane][I++ & 0xFFF];
+            }
+            break;
+        default:
+            // Batches run the original instruction set only
+            break;
+    }
+}
+
+void Batch::write_memory(int lane, int address, uint8_t value) {
+    memory[lane][address] = value;
+    written[address] = true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "clock.h"
+#include "display.h"
+#include "instruction.h"
+#include "keypad.h"
+#include "memory.h"
+
+// Runs many machines with the same rom in lockstep, with results identical to running a Chip8
+// per machine. Registers, I, pc, sp and the timers are stored as struct-of-arrays across
+// machines ("lanes"). While every lane is at the same instruction, register instructions run
+// as SIMD kernels over all lanes at once. Lanes at different addresses run one at a time until
+// they meet again. Batches run the original Chip8 only, see Variant.
+class Batch {
+   public:
+    explicit Batch(int size);
+
+    void reset();
+    void load_rom(std::string filename);
+    void load_rom(const Rom& rom);
+    void run_frame(Clock::Frame frame);
+    void run(int cycles);
+    void tick();
+    void set_key(int lane, int key, int val);
+
+    // Seeds the random number generator of a lane. The seed is kept across resets.
+    void seed(int lane, uint64_t value);
+
+    const Display& get_display(int lane) const;
+
+    int size() const {
+        return count;
+    }
+
+   private:
+    int count;  // Lanes in use
+    int lanes;  // Lanes allocated, a multiple of the SIMD width
+
+    std::array<std::vector<uint8_t>, 0x10> regs;  // regs[x][lane]
+    std::vector<uint16_t> I;
+    std::vector<uint16_t> pc;
+    std::vector<uint16_t> sp;
+    std::vector<uint8_t> delay_timer;
+    std::vector<uint8_t> sound_timer;
+    std::vector<uint64_t> rng;
+    std::vector<uint64_t> seeds;
+
+    std::vector<std::array<uint16_t, 0x10>> stack;
+    std::vector<Memory> memory;
+    std::vector<Display> display;
+    std::vector<Keypad> keypad;
+
+    // Addresses that any lane wrote to since the rom was loaded. Memory outside of them is the
+    // same in every lane, and so are its decoded instructions.
+    std::bitset<0x1000> written;
+    std::array<Instruction, 0x1000> icache = {};
+
+    static constexpr int idle_check_interval = 64;
+    int unchecked = 0;
+    int wait_period = 0;
+
+    int waiting() const;
+    bool uniform_pc() const;
+    bool uniform_opcode(int address) const;
+    const Instruction& fetch(int lane, Instruction& scratch);
+
+    bool execute_all(const Instruction& ins);
+    void execute(int lane, const Instruction& ins);
+    void write_memory(int lane, int address, uint8_t value);
+};
@@ -0,0 +1,185 @@
+#include "block_executor.h"
+
+#include <algorithm>
+
+#include "chip8.h"
+
+// Runs whole blocks while the budget allows it and interprets the remaining instructions.
+void BlockExecutor::run(Chip8& chip8, int cycles) {
+    while (cycles > 0) {
+        auto block = lookup(chip8);
+        if (block == nullptr || block->length > cycles) {
+            chip8.tick();
+            cycles--;
+            continue;
+        }
+        cycles -= execute(chip8, &code[block->offset]);
+    }
+}
+
+// Drops every block that contains the byte at the given address.
+void BlockExecutor::invalidate(int address) {
+    address &= 0xFFF;
+    if (!covered[address]) {
+        return;
+    }
+    for (auto start = std::max(0, address - 2 * max_length); start <= address; start++) {
+        auto& block = blocks[start];
+        if (block.length > 0 && address < start + 2 * block.length) {
+            block.length = 0;
+        }
+    }
+}
+
+void BlockExecutor::flush() {
+    blocks.fill({});
+    code.clear();
+    code.reserve(max_code + max_length + 1);
+    covered.reset();
+}
+
+// Returns the block starting at the program counter, translating it on first use.
+// Returns nullptr if there is no complete instruction at the program counter.
+const BlockExecutor::Block* BlockExecutor::lookup(Chip8& chip8) {
+    if (chip8.pc + 1 >= static_cast<int>(blocks.size())) {
+        return nullptr;
+    }
+    auto block = &blocks[chip8.pc];
+    if (block->length == 0) {
+        translate(chip8, chip8.pc);
+    }
+    return block;
+}
+
+// Decodes instructions starting at the given address until one of them ends the block.
+// The block is terminated by an exit instruction.
+void BlockExecutor::translate(Chip8& chip8, int start) {
+    if (code.size() > max_code) {
+        flush();
+    }
+
+    auto& block = blocks[start];
+    block.offset = code.size();
+
+    for (auto address = start; address + 1 < static_cast<int>(blocks.size()); address += 2) {
+        auto ins = Chip8::decode(chip8.memory[address] << 8 | chip8.memory[address + 1], chip8.variant);
+        code.push_back(ins);
+        covered[address] = true;
+        covered[address + 1] = true;
+        block.length++;
+        if (ends_block(ins.op) || block.length == max_length) {
+            break;
+        }
+    }
+
+    Instruction exit;
+    exit.op = Op::exit;
+    code.push_back(exit);
+}
+
+// Runs instructions until the exit instruction or a taken skip and returns how many were run.
+// Dispatch jumps straight from the body of one instruction to the next, using computed goto
+// where the compiler supports it.
+int BlockExecutor::execute(Chip8& chip8, const Instruction* ins) {
+    auto first = ins;
+    uint16_t next = 0;
+
+#if defined(__GNUC__)
+    static const void* labels[op_count] = {
+        &&op_nop, &&op_cls, &&op_ret, &&op_jmp, &&op_call, &&op_se_byte, &&op_sne_byte,
+        &&op_se_reg, &&op_ld_byte, &&op_add_byte, &&op_ld_reg, &&op_fn_or, &&op_fn_and,
+        &&op_fn_xor, &&op_add_reg, &&op_sub, &&op_shr, &&op_subn, &&op_shl, &&op_sne, &&op_ld,
+        &&op_jp_reg, &&op_rnd, &&op_drw, &&op_skp, &&op_sknp, &&op_ld_delay_timer,
+        &&op_ld_timer_wait, &&op_ld_delay_timer_set, &&op_ld_sound_timer_set, &&op_add_i_reg,
+        &&op_set_i_reg, &&op_bcd, &&op_cpy_regs_to_mem, &&op_cpy_mem_to_regs, &&op_scroll_down,
+        &&op_scroll_right, &&op_scroll_left, &&op_halt, &&op_lores, &&op_hires, &&op_set_i_big,
+        &&op_save_flags, &&op_load_flags, &&op_scroll_up, &&op_save_range, &&op_load_range,
+        &&op_ld_long, &&op_plane, &&op_audio, &&op_ld_pitch, &&op_exit,
+    };
+#define CASE(name) op_##name : next = chip8.pc += 2;
+#define NEXT() goto* labels[static_cast<int>((++ins)->op)]
+#define SKIP()                  \
+    if (chip8.pc != next) {     \
+        return ins - first + 1; \
+    }                           \
+    NEXT()
+    goto* labels[static_cast<int>(ins->op)];
+#else
+#define CASE(name) \
+    case Op::name: \
+        next = chip8.pc += 2;
+#define NEXT() \
+    ins++;     \
+    continue
+#define SKIP()              \
+    if (chip8.pc != next) { \
+        return ins - first + 1; \
+    }                       \
+    NEXT()
+    for (;;) {
+        switch (ins->op) {
+#endif
+    CASE(nop) NEXT();
+    CASE(cls) chip8.cls(); NEXT();
+    CASE(ret) chip8.ret(); NEXT();
+    CASE(jmp) chip8.jmp(ins->nnn); NEXT();
+    CASE(call) chip8.call(ins->nnn); NEXT();
+    CASE(se_byte) chip8.se_byte(ins->x, ins->kk); SKIP();
+    CASE(sne_byte) chip8.sne_byte(ins->x, ins->kk); SKIP();
+    CASE(se_reg) chip8.se_reg(ins->x, ins->y); SKIP();
+    CASE(ld_byte) chip8.ld_byte(ins->x, ins->kk); NEXT();
+    CASE(add_byte) chip8.add_byte(ins->x, ins->kk); NEXT();
+    CASE(ld_reg) chip8.ld_reg(ins->x, ins->y); NEXT();
+    CASE(fn_or) chip8.fn_or(ins->x, ins->y); NEXT();
+    CASE(fn_and) chip8.fn_and(ins->x, ins->y); NEXT();
+    CASE(fn_xor) chip8.fn_xor(ins->x, ins->y); NEXT();
+    CASE(add_reg) chip8.add_reg(ins->x, ins->y); NEXT();
+    CASE(sub) chip8.sub(ins->x, ins->y); NEXT();
+    CASE(shr) chip8.shr(ins->x); NEXT();
+    CASE(subn) chip8.subn(ins->x, ins->y); NEXT();
+    CASE(shl) chip8.shl(ins->x); NEXT();
+    CASE(sne) chip8.sne(ins->x, ins->y); SKIP();
+    CASE(ld) chip8.ld(ins->nnn); NEXT();
+    CASE(jp_reg) chip8.jp_reg(ins->nnn); NEXT();
+    CASE(rnd) chip8.rnd(ins->x, ins->kk); NEXT();
+    CASE(drw) chip8.drw(ins->x, ins->y, ins->n); NEXT();
+    CASE(skp) chip8.skp(ins->x); SKIP();
+    CASE(sknp) chip8.sknp(ins->x); SKIP();
+    CASE(ld_delay_timer) chip8.ld_delay_timer(ins->x); NEXT();
+    CASE(ld_timer_wait) chip8.ld_timer_wait(ins->x); NEXT();
+    CASE(ld_delay_timer_set) chip8.ld_delay_timer_set(ins->x); NEXT();
+    CASE(ld_sound_timer_set) chip8.ld_sound_timer_set(ins->x); NEXT();
+    CASE(add_i_reg) chip8.add_i_reg(ins->x); NEXT();
+    CASE(set_i_reg) chip8.set_i_reg(ins->x); NEXT();
+    CASE(bcd) chip8.bcd(ins->x); NEXT();
+    CASE(cpy_regs_to_mem) chip8.cpy_regs_to_mem(ins->x); NEXT();
+    CASE(cpy_mem_to_regs) chip8.cpy_mem_to_regs(ins->x); NEXT();
+    CASE(scroll_down) chip8.scroll_down(ins->n); NEXT();
+    CASE(scroll_right) chip8.scroll_right(); NEXT();
+    CASE(scroll_left) chip8.scroll_left(); NEXT();
+    CASE(halt) chip8.halt(); NEXT();
+    CASE(lores) chip8.lores(); NEXT();
+    CASE(hires) chip8.hires(); NEXT();
+    CASE(set_i_big) chip8.set_i_big(ins->x); NEXT();
+    CASE(save_flags) chip8.save_flags(ins->x); NEXT();
+    CASE(load_flags) chip8.load_flags(ins->x); NEXT();
+    CASE(scroll_up) chip8.scroll_up(ins->n); NEXT();
+    CASE(save_range) chip8.save_range(ins->x, ins->y); NEXT();
+    CASE(load_range) chip8.load_range(ins->x, ins->y); NEXT();
+    CASE(ld_long) chip8.ld_long(); NEXT();
+    CASE(plane) chip8.plane(ins->x); NEXT();
+    CASE(audio) chip8.audio(); NEXT();
+    CASE(ld_pitch) chip8.ld_pitch(ins->x); NEXT();
+#if defined(__GNUC__)
+op_exit:
+    return ins - first;
+#else
+        case Op::exit:
+            return ins - first;
+        }
+    }
+#endif
+#undef CASE
+#undef NEXT
+#undef SKIP
+}
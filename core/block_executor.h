@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+#include "executor.h"
+#include "instruction.h"
+
+// Splits code into basic blocks of predecoded instructions and runs whole blocks with
+// direct-threaded dispatch. A block ends at the first instruction that sets the program
+// counter or writes to memory, so a block never runs past a write into itself. Taken skips
+// leave a block early.
+class BlockExecutor : public Executor {
+   public:
+    static constexpr int max_length = 32;
+
+    BlockExecutor() {
+        flush();
+    }
+
+    void run(Chip8& chip8, int cycles) override;
+    void invalidate(int address) override;
+    void flush() override;
+
+   private:
+    static constexpr std::size_t max_code = 0x4000;
+
+    struct Block {
+        uint32_t offset = 0;  // Index of the first instruction in code
+        uint16_t length = 0;  // Number of instructions, 0 if not translated
+    };
+
+    std::array<Block, 0x1000> blocks;
+    std::vector<Instruction> code;
+    std::bitset<0x1000> covered;  // Bytes that belong to any translated block
+
+    const Block* lookup(Chip8& chip8);
+    void translate(Chip8& chip8, int start);
+    static int execute(Chip8& chip8, const Instruction* ins);
+};
@@ -1,12 +1,25 @@
 #include "chip8.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+
+#include "block_executor.h"
+#include "jit_executor.h"
+#include "static_executor.h"
 
 // Resets to initial state.
 void Chip8::reset() {
     memory.reset();
+    if (variant != Variant::Chip8) {
+        memory.load_big_sprites();
+    }
+    if (extended) {
+        extended->memory.fill(0);
+    }
     keypad.reset();
-    display.clear();
+    display.reset();
 
     regs = {0};
     stack = {0};
@@ -15,11 +28,41 @@ void Chip8::reset() {
     sp = 0;
     delay_timer = 0;
     sound_timer = 0;
+    rng = seed_value;
+    cycle_count = 0;
+    flags = {0};
+    audio_pattern = {0};
+    pitch = 64;
+
+    icache.fill({});
+    if (executor) {
+        executor->flush();
+    }
 }
 
 // Loads the data of a given file to the memory
 void Chip8::load_rom(std::string filename) {
-    memory.load_rom(filename);
+    load_rom(Rom::from_file(filename));
+}
+
+// Loads a rom image to the memory. Only XO-CHIP programs may be larger than 4 KB, their
+// remainder goes into the extended memory.
+void Chip8::load_rom(const Rom& rom) {
+    if (rom.size() > static_cast<std::size_t>(address_mask() + 1 - memory.offset)) {
+        throw std::runtime_error("Out of memory!\n");
+    }
+    auto low = static_cast<std::size_t>(Memory::size() - Memory::offset);
+    if (rom.size() <= low) {
+        memory.load_rom(rom);
+    } else {
+        auto& bytes = rom.data();
+        memory.load_rom(Rom(bytes.data(), low));
+        std::copy(bytes.begin() + low, bytes.end(), extended->memory.begin());
+    }
+    icache.fill({});
+    if (executor) {
+        executor->flush();
+    }
 }
 
 // Decrements the delay timer if it is above 0.
@@ -37,122 +80,460 @@ bool Chip8::update_sound_timer() {
     return sound_timer > 0;
 }
 
-// Sets a given key in the underlying keyboard.
+// Presses (val != 0) or releases one of the 16 keys.
 void Chip8::set_key(int key, int val) {
-    keypad[key] = val;
+    if (recording != nullptr && keypad.is_pressed(key) != (val != 0)) {
+        recording->record(cycle_count, key, val != 0);
+    }
+    keypad.set(key, val != 0);
+}
+
+void Chip8::record(Movie* movie) {
+    recording = movie;
+}
+
+// Runs the given number of instructions, with the executor of the current execution mode.
+// Every idle_check_interval instructions, counted across runs, the program is checked for a
+// wait loop. Once it waits, only the instructions of the last partial iteration run, which
+// leaves the machine exactly where running every iteration would. A loop that was found is
+// checked again after its first iteration in the next run, once it read the new timer value.
+// Without idle skipping every instruction runs, in one go.
+void Chip8::run(int cycles) {
+    cycle_count += cycles;
+    if (wait_period > 0) {
+        unchecked = idle_check_interval - wait_period;
+    }
+    while (cycles > 0) {
+        if (unchecked >= idle_check_interval) {
+            wait_period = idle_skipping ? waiting() : 0;
+            unchecked = 0;
+            if (wait_period > 0) {
+                idle_count += cycles - cycles % wait_period;
+                cycles %= wait_period;
+            }
+        }
+        auto slice = idle_skipping ? std::min(cycles, idle_check_interval - unchecked) : cycles;
+        if (executor) {
+            executor->run(*this, slice);
+        } else {
+            for (auto i = 0; i < slice; i++) {
+                tick();
+            }
+        }
+        unchecked += slice;
+        cycles -= slice;
+    }
+}
+
+// Returns the length of the wait loop the program is in, or 0 if it is not waiting.
+int Chip8::waiting() const {
+    auto fetch = [this](int address) {
+        auto& ins = icache[address];
+        return ins.handler != nullptr ? ins : this->fetch(address);
+    };
+    return wait_loop(pc, fetch, [this](int x) { return regs[x]; }, I, delay_timer, keypad.state());
+}
+
+// Decodes the instruction at an address without caching it.
+Instruction Chip8::fetch(int address) const {
+    auto mask = address_mask();
+    return decode(read_memory(address & mask) << 8 | read_memory((address + 1) & mask), variant);
+}
+
+// Runs one frame of emulated time: first the timer ticks, then the CPU cycles.
+void Chip8::run_frame(Clock::Frame frame) {
+    for (auto i = 0; i < frame.timer_ticks; i++) {
+        update_delay_timer();
+        update_sound_timer();
+    }
+    run(frame.cycles);
+}
+
+// Selects how run() executes instructions. All modes behave the same. The JIT falls back to
+// the interpreter on hosts it does not support, and to blocks for XO-CHIP, whose skips over
+// four byte instructions it does not compile. Static code runs only for roms compiled into
+// the binary and interprets all others.
+void Chip8::set_execution_mode(ExecutionMode mode) {
+    this->mode = mode;
+    if (mode == ExecutionMode::Jit && variant == Variant::XoChip) {
+        mode = ExecutionMode::Blocks;
+    }
+    switch (mode) {
+        case ExecutionMode::Interpreter:
+            executor.reset();
+            break;
+        case ExecutionMode::Blocks:
+            executor = std::make_unique<BlockExecutor>();
+            break;
+        case ExecutionMode::Jit:
+            if (JitExecutor::available()) {
+                executor = std::make_unique<JitExecutor>();
+            } else {
+                executor.reset();
+            }
+            break;
+        case ExecutionMode::Static:
+            executor = std::make_unique<StaticExecutor>();
+            break;
+    }
+}
+
+void Chip8::set_variant(Variant value) {
+    variant = value;
+    if (variant != Variant::XoChip) {
+        extended.reset();
+    } else if (!extended) {
+        extended = std::make_unique<ExtendedState>();
+    }
+    icache.fill({});
+    set_execution_mode(mode);
+}
+
+void Chip8::set_idle_skipping(bool enabled) {
+    idle_skipping = enabled;
+    wait_period = 0;
+}
+
+void Chip8::seed(uint64_t value) {
+    seed_value = value;
+    rng = value;
+}
+
+// Copies the complete machine state into the given snapshot.
+void Chip8::save(MachineState& state) const {
+    std::memcpy(&state, static_cast<const MachineState*>(this), sizeof(MachineState));
+}
+
+// Restores a snapshot taken with save(). Decoded instructions are only dropped for the
+// addresses whose memory differs, so restoring a snapshot of the same program keeps the caches
+// warm.
+void Chip8::load(const MachineState& state) {
+    auto current = memory.data();
+    auto next = state.memory.data();
+    for (auto address = 0; address < Memory::size(); address += 8) {
+        if (std::memcmp(current + address, next + address, 8) == 0) {
+            continue;
+        }
+        for (auto i = address; i < address + 8; i++) {
+            if (current[i] != next[i]) {
+                invalidate(i);
+            }
+        }
+    }
+    std::memcpy(static_cast<MachineState*>(this), &state, sizeof(MachineState));
 }
 
-// Fetch, decode and execute the instruction at the current program counter.
+void Chip8::save(ExtendedState& state) const {
+    if (extended) {
+        std::memcpy(&state, extended.get(), sizeof(ExtendedState));
+    }
+}
+
+// Nothing above 4 KB is cached, so the extended memory is copied as it is.
+void Chip8::load(const ExtendedState& state) {
+    if (extended) {
+        std::memcpy(extended.get(), &state, sizeof(ExtendedState));
+    }
+}
+
+// Handlers of all operations, indexed by Op.
+const std::array<Instruction::Handler, op_count> Chip8::handlers = {
+    &nop,
+    &op<&Chip8::cls>,
+    &op<&Chip8::ret>,
+    &op_nnn<&Chip8::jmp>,
+    &op_nnn<&Chip8::call>,
+    &op_xkk<&Chip8::se_byte>,
+    &op_xkk<&Chip8::sne_byte>,
+    &op_xy<&Chip8::se_reg>,
+    &op_xkk<&Chip8::ld_byte>,
+    &op_xkk<&Chip8::add_byte>,
+    &op_xy<&Chip8::ld_reg>,
+    &op_xy<&Chip8::fn_or>,
+    &op_xy<&Chip8::fn_and>,
+    &op_xy<&Chip8::fn_xor>,
+    &op_xy<&Chip8::add_reg>,
+    &op_xy<&Chip8::sub>,
+    &op_x<&Chip8::shr>,
+    &op_xy<&Chip8::subn>,
+    &op_x<&Chip8::shl>,
+    &op_xy<&Chip8::sne>,
+    &op_nnn<&Chip8::ld>,
+    &op_nnn<&Chip8::jp_reg>,
+    &op_xkk<&Chip8::rnd>,
+    &op_xyn<&Chip8::drw>,
+    &op_x<&Chip8::skp>,
+    &op_x<&Chip8::sknp>,
+    &op_x<&Chip8::ld_delay_timer>,
+    &op_x<&Chip8::ld_timer_wait>,
+    &op_x<&Chip8::ld_delay_timer_set>,
+    &op_x<&Chip8::ld_sound_timer_set>,
+    &op_x<&Chip8::add_i_reg>,
+    &op_x<&Chip8::set_i_reg>,
+    &op_x<&Chip8::bcd>,
+    &op_x<&Chip8::cpy_regs_to_mem>,
+    &op_x<&Chip8::cpy_mem_to_regs>,
+    &op_n<&Chip8::scroll_down>,
+    &op<&Chip8::scroll_right>,
+    &op<&Chip8::scroll_left>,
+    &op<&Chip8::halt>,
+    &op<&Chip8::lores>,
+    &op<&Chip8::hires>,
+    &op_x<&Chip8::set_i_big>,
+    &op_x<&Chip8::save_flags>,
+    &op_x<&Chip8::load_flags>,
+    &op_n<&Chip8::scroll_up>,
+    &op_xy<&Chip8::save_range>,
+    &op_xy<&Chip8::load_range>,
+    &op<&Chip8::ld_long>,
+    &op_x<&Chip8::plane>,
+    &op<&Chip8::audio>,
+    &op_x<&Chip8::ld_pitch>,
+    &nop,
+};
+
+// Fetch, decode and execute the instruction at the current program counter. Decoded
+// instructions are cached per address, so only the first execution pays for the decode.
 void Chip8::tick() {
-    // Fetch
-    auto opcode = memory[pc] << 8 | memory[pc + 1];
+    if (pc >= icache.size()) {
+        auto ins = fetch(pc);
+        pc += 2;
+        return ins.handler(*this, ins);
+    }
 
-    // Decode
-    auto type = (opcode >> 12) & 0x000F;
-    auto n = opcode & 0x000F;
-    auto x = (opcode >> 8) & 0x000F;
-    auto y = (opcode >> 4) & 0x000F;
-    auto kk = opcode & 0x00FF;
-    auto nnn = opcode & 0x0FFF;
+    auto& ins = icache[pc];
+    if (ins.handler == nullptr) {
+        ins = fetch(pc);
+    }
 
     // Execute
     pc += 2;
+    ins.handler(*this, ins);
+}
+
+// Decodes an opcode into its handler and operands. The instructions that a variant adds are
+// only decoded for it and the variants after it.
+Instruction Chip8::decode(int opcode, Variant variant) {
+    Instruction ins;
+    ins.n = opcode & 0x000F;
+    ins.x = (opcode >> 8) & 0x000F;
+    ins.y = (opcode >> 4) & 0x000F;
+    ins.kk = opcode & 0x00FF;
+    ins.nnn = opcode & 0x0FFF;
+
+    auto type = (opcode >> 12) & 0x000F;
+    auto schip = variant != Variant::Chip8;
+    auto xochip = variant == Variant::XoChip;
 
     switch (type) {
         case 0x00:
-            switch (nnn) {
+            switch (ins.nnn) {
                 case 0xE0:
-                    return cls();
+                    ins.op = Op::cls;
+                    break;
                 case 0xEE:
-                    return ret();
+                    ins.op = Op::ret;
+                    break;
+                case 0xFB:
+                    ins.op = schip ? Op::scroll_right : Op::nop;
+                    break;
+                case 0xFC:
+                    ins.op = schip ? Op::scroll_left : Op::nop;
+                    break;
+                case 0xFD:
+                    ins.op = schip ? Op::halt : Op::nop;
+                    break;
+                case 0xFE:
+                    ins.op = schip ? Op::lores : Op::nop;
+                    break;
+                case 0xFF:
+                    ins.op = schip ? Op::hires : Op::nop;
+                    break;
                 default:
-                    return;
+                    if (schip && (ins.nnn & 0xFF0) == 0x0C0) {
+                        ins.op = Op::scroll_down;
+                    } else if (xochip && (ins.nnn & 0xFF0) == 0x0D0) {
+                        ins.op = Op::scroll_up;
+                    }
+                    break;
             }
+            break;
         case 0x01:
-            return jmp(nnn);
+            ins.op = Op::jmp;
+            break;
         case 0x02:
-            return call(nnn);
+            ins.op = Op::call;
+            break;
         case 0x03:
-            return se_byte(x, kk);
+            ins.op = Op::se_byte;
+            break;
         case 0x04:
-            return sne_byte(x, kk);
+            ins.op = Op::sne_byte;
+            break;
         case 0x05:
-            return se_reg(x, y);
+            if (xochip && ins.n == 0x2) {
+                ins.op = Op::save_range;
+            } else if (xochip && ins.n == 0x3) {
+                ins.op = Op::load_range;
+            } else {
+                ins.op = Op::se_reg;
+            }
+            break;
         case 0x06:
-            return ld_byte(x, kk);
+            ins.op = Op::ld_byte;
+            break;
         case 0x07:
-            return add_byte(x, kk);
+            ins.op = Op::add_byte;
+            break;
         case 0x08:
-            switch (n) {
+            switch (ins.n) {
                 case 0x0:
-                    return ld_reg(x, y);
+                    ins.op = Op::ld_reg;
+                    break;
                 case 0x1:
-                    return fn_or(x, y);
+                    ins.op = Op::fn_or;
+                    break;
                 case 0x2:
-                    return fn_and(x, y);
+                    ins.op = Op::fn_and;
+                    break;
                 case 0x3:
-                    return fn_xor(x, y);
+                    ins.op = Op::fn_xor;
+                    break;
                 case 0x4:
-                    return add_reg(x, y);
+                    ins.op = Op::add_reg;
+                    break;
                 case 0x5:
-                    return sub(x, y);
+                    ins.op = Op::sub;
+                    break;
                 case 0x6:
-                    return shr(x);
+                    ins.op = Op::shr;
+                    break;
                 case 0x7:
-                    return subn(x, y);
+                    ins.op = Op::subn;
+                    break;
                 case 0xE:
-                    return shl(x);
-                default:
-                    return;
+                    ins.op = Op::shl;
+                    break;
             }
+            break;
         case 0x09:
-            return sne(x, y);
+            ins.op = Op::sne;
+            break;
         case 0xA:
-            return ld(nnn);
+            ins.op = Op::ld;
+            break;
         case 0xB:
-            return jp_reg(nnn);
+            ins.op = Op::jp_reg;
+            break;
         case 0xC:
-            return rnd(x, kk);
+            ins.op = Op::rnd;
+            break;
         case 0xD:
-            return drw(x, y, n);
+            ins.op = Op::drw;
+            break;
         case 0xE:
-            if (kk == 0x9E) {
-                return skp(x);
+            if (ins.kk == 0x9E) {
+                ins.op = Op::skp;
+                break;
             }
-            if (kk == 0xA1) {
-                return sknp(x);
+            if (ins.kk == 0xA1) {
+                ins.op = Op::sknp;
+                break;
             }
+            // Unknown Ex opcodes are decoded like Fx opcodes
+            [[fallthrough]];
         case 0xF:
-            switch (kk) {
+            switch (ins.kk) {
+                case 0x00:
+                    ins.op = xochip && opcode == 0xF000 ? Op::ld_long : Op::nop;
+                    break;
+                case 0x01:
+                    ins.op = xochip ? Op::plane : Op::nop;
+                    break;
+                case 0x02:
+                    ins.op = xochip && opcode == 0xF002 ? Op::audio : Op::nop;
+                    break;
                 case 0x07:
-                    return ld_delay_timer(x);
+                    ins.op = Op::ld_delay_timer;
+                    break;
                 case 0x0A:
-                    return ld_timer_wait(x);
+                    ins.op = Op::ld_timer_wait;
+                    break;
                 case 0x15:
-                    return ld_delay_timer_set(x);
+                    ins.op = Op::ld_delay_timer_set;
+                    break;
                 case 0x18:
-                    return ld_sound_timer_set(x);
+                    ins.op = Op::ld_sound_timer_set;
+                    break;
                 case 0x1E:
-                    return add_i_reg(x);
+                    ins.op = Op::add_i_reg;
+                    break;
                 case 0x29:
-                    return set_i_reg(x);
+                    ins.op = Op::set_i_reg;
+                    break;
+                case 0x30:
+                    ins.op = schip ? Op::set_i_big : Op::nop;
+                    break;
                 case 0x33:
-                    return bcd(x);
+                    ins.op = Op::bcd;
+                    break;
+                case 0x3A:
+                    ins.op = xochip ? Op::ld_pitch : Op::nop;
+                    break;
                 case 0x55:
-                    return cpy_regs_to_mem(x);
+                    ins.op = Op::cpy_regs_to_mem;
+                    break;
                 case 0x65:
-                    return cpy_mem_to_regs(x);
-                default:
-                    return;
+                    ins.op = Op::cpy_mem_to_regs;
+                    break;
+                case 0x75:
+                    ins.op = schip ? Op::save_flags : Op::nop;
+                    break;
+                case 0x85:
+                    ins.op = schip ? Op::load_flags : Op::nop;
+                    break;
             }
-        default:
-            return;
+            break;
+    }
+
+    ins.handler = handlers[static_cast<int>(ins.op)];
+    return ins;
+}
+
+// Writes a byte to memory and drops the cached instructions that contain it.
+void Chip8::write_memory(int address, uint8_t value) {
+    if (address < Memory::size()) {
+        memory[address] = value;
+    } else {
+        extended->memory[address - Memory::size()] = value;
     }
+    invalidate(address);
 }
 
-// Returns the pixel at the given index.
-uint8_t Chip8::get_pixel(int i) {
-    return display[i];
+// Drops the cached instructions and translated code that contain the byte at the given address.
+void Chip8::invalidate(int address) {
+    icache[address & 0xFFF] = {};
+    icache[(address - 1) & 0xFFF] = {};
+    if (executor) {
+        executor->invalidate(address);
+    }
+}
+
+// Skips the next instruction. In XO-CHIP that is four bytes long if it is F000 NNNN.
+void Chip8::skip() {
+    if (variant == Variant::XoChip && read_memory(pc) == 0xF0 && read_memory((pc + 1) & 0xFFFF) == 0x00) {
+        pc += 2;
+    }
+    pc += 2;
+}
+
+// Returns a row of pixels, see Display.
+uint64_t Chip8::get_row(int y) {
+    return display.row(y);
+}
+
+const Display& Chip8::get_display() const {
+    return display;
 }
 
 void Chip8::cls() {
@@ -165,7 +546,7 @@ void Chip8::cls() {
 // then subtracts 1 from the stack pointer.
 void Chip8::ret() {
     // std::cout << __func__ << std::endl;
-    pc = stack[--sp];
+    pc = DefaultAccess::at(stack, --sp);
 }
 
 // JP addr: Jump to location nnn.
@@ -180,7 +561,7 @@ void Chip8::jmp(int nnn) {
 // stack. The PC is then set to nnn.
 void Chip8::call(int nnn) {
     // std::cout << __func__ << std::endl;
-    stack[sp++] = pc;
+    DefaultAccess::at(stack, sp++) = pc;
     pc = nnn;
 }
 
@@ -190,7 +571,7 @@ void Chip8::call(int nnn) {
 void Chip8::se_byte(int x, int kk) {
     // std::cout << __func__ << std::endl;
     if (regs[x] == kk) {
-        pc += 2;
+        skip();
     }
 }
 
@@ -200,7 +581,7 @@ void Chip8::se_byte(int x, int kk) {
 void Chip8::sne_byte(int x, int kk) {
     // std::cout << __func__ << std::endl;
     if (regs[x] != kk) {
-        pc += 2;
+        skip();
     }
 }
 
@@ -210,7 +591,7 @@ void Chip8::sne_byte(int x, int kk) {
 void Chip8::se_reg(int x, int y) {
     // std::cout << __func__ << std::endl;
     if (regs[x] == regs[y]) {
-        pc += 2;
+        skip();
     }
 }
 
@@ -308,7 +689,7 @@ void Chip8::shl(int x) {
 void Chip8::sne(int x, int y) {
     // std::cout << __func__ << std::endl;
     if (regs[x] != regs[y]) {
-        pc += 2;
+        skip();
     }
 }
 
@@ -331,8 +712,7 @@ void Chip8::jp_reg(int nnn) {
 // the value kk. The results are stored in Vx.
 void Chip8::rnd(int x, int kk) {
     // std::cout << __func__ << std::endl;
-    // TODO: implement me
-    regs[x] = 1 & kk;
+    regs[x] = prng::next(rng) & kk;
 }
 
 // DRW Vx, Vy, nibble: Display n-byte sprite starting at memory location I at (Vx, Vy),
@@ -344,19 +724,43 @@ void Chip8::rnd(int x, int kk) {
 // outside the coordinates of the display, it wraps around to the opposite side of the screen.
 void Chip8::drw(int x, int y, int n) {
     // std::cout << __func__ << std::endl;
+    if (variant != Variant::Chip8) {
+        return drw_planes(x, y, n);
+    }
     regs[0xF] = 0;
 
+    auto px = regs[x];
+    auto py = regs[y];
+
     for (auto row = 0; row < n; row++) {
-        auto sprite = memory[I + row];
-        for (auto col = 0; col < 8; col++) {
-            if (sprite & (0b10000000 >> col)) {
-                auto px = regs[x] + col;
-                auto py = regs[y] + row;
-                auto pixel = px + py * display.m_width;
-                if (display[pixel]) {
-                    regs[0x0F] = 1;
-                }
-                display[pixel] ^= 1;
+        if (display.draw(px, py + row, memory[(I + row) & 0xFFF])) {
+            regs[0x0F] = 1;
+        }
+    }
+}
+
+// DRW in SUPER-CHIP and XO-CHIP: Draws n rows of 8 pixels, or 16 rows of 16 pixels for n = 0,
+// at the current resolution. The sprite is drawn into every selected plane, with the data of
+// one plane after the other.
+void Chip8::drw_planes(int x, int y, int n) {
+    regs[0xF] = 0;
+
+    auto wide = n == 0;
+    auto rows = wide ? 16 : n;
+    auto mask = address_mask();
+    auto address = static_cast<int>(I);
+
+    for (auto plane = 0; plane < Display::planes; plane++) {
+        if ((display.selected_planes() & (1 << plane)) == 0) {
+            continue;
+        }
+        for (auto row = 0; row < rows; row++) {
+            uint16_t sprite = read_memory(address++ & mask);
+            if (wide) {
+                sprite = sprite << 8 | read_memory(address++ & mask);
+            }
+            if (display.draw(plane, regs[x], regs[y] + row, sprite, wide ? 16 : 8)) {
+                regs[0xF] = 1;
             }
         }
     }
@@ -368,7 +772,7 @@ void Chip8::drw(int x, int y, int n) {
 void Chip8::skp(int x) {
     // std::cout << __func__ << std::endl;
     if (keypad.is_pressed(regs[x]) == 1) {
-        pc += 2;
+        skip();
     }
 }
 
@@ -378,7 +782,7 @@ void Chip8::skp(int x) {
 void Chip8::sknp(int x) {
     // std::cout << __func__ << std::endl;
     if (keypad.is_pressed(regs[x]) == 0) {
-        pc += 2;
+        skip();
     }
 }
 
@@ -391,12 +795,15 @@ void Chip8::ld_delay_timer(int x) {
 
 // Ld Vx, K: Wait for a key press, store the value of the key in Vx.
 // All execution stops until a key is pressed, then the value of that key is stored in Vx.
+// The instruction repeats itself until then, which run() recognizes as a wait loop.
 void Chip8::ld_timer_wait(int x) {
     // std::cout << __func__ << std::endl;
-    for (auto i = 0; i < 0x0F; i++) {
-        if (keypad.is_pressed(i)) {
-            regs[x] = i;
-        }
+    // The highest pressed key below F wins
+    auto key = keypad.highest_pressed(0x7FFF);
+    if (key >= 0) {
+        regs[x] = key;
+    } else {
+        pc -= 2;
     }
 }
 
@@ -434,26 +841,142 @@ void Chip8::set_i_reg(int x) {
 // at location in I, the tens digit at location I+1, and the ones digit at location I+2.
 void Chip8::bcd(int x) {
     // std::cout << __func__ << std::endl;
-    memory[(I + 0) & 0xFFF] = (regs[x] % 1000) / 100;
-    memory[(I + 1) & 0xFFF] = (regs[x] % 100) / 10;
-    memory[(I + 2) & 0xFFF] = regs[x] % 10;
+    auto mask = address_mask();
+    write_memory((I + 0) & mask, (regs[x] % 1000) / 100);
+    write_memory((I + 1) & mask, (regs[x] % 100) / 10);
+    write_memory((I + 2) & mask, regs[x] % 10);
 }
 
 // LD [I], Vx: Store registers V0 through Vx in memory starting at location I.
 // The interpreter copies the values of registers V0 through Vx into memory, starting at
-// the address in I.
+// the address in I. SUPER-CHIP leaves I as it is.
 void Chip8::cpy_regs_to_mem(int x) {
     // std::cout << __func__ << std::endl;
+    auto mask = address_mask();
+    auto address = I;
     for (auto index = 0; index < x; index++) {
-        memory[I++ & 0xFFF] = regs[index];
+        write_memory(address++ & mask, regs[index]);
+    }
+    if (variant != Variant::SuperChip) {
+        I = address;
     }
 }
 
 // LD Vx, [I]: Read registers V0 through Vx from memory starting at location I.
 // The interpreter reads values from memory starting at location I into registers V0 through Vx.
+// SUPER-CHIP leaves I as it is.
 void Chip8::cpy_mem_to_regs(int x) {
     // std::cout << __func__ << std::endl;
+    auto mask = address_mask();
+    auto address = I;
     for (auto index = 0; index < x; index++) {
-        regs[index] = memory[I++ & 0xFFF];
+        regs[index] = read_memory(address++ & mask);
+    }
+    if (variant != Variant::SuperChip) {
+        I = address;
     }
+}
+
+// SCD nibble: Scroll the display down by n pixels.
+void Chip8::scroll_down(int n) {
+    display.scroll_down(n);
+}
+
+// SCR: Scroll the display right by 4 pixels.
+void Chip8::scroll_right() {
+    display.scroll_right(4);
+}
+
+// SCL: Scroll the display left by 4 pixels.
+void Chip8::scroll_left() {
+    display.scroll_left(4);
+}
+
+// EXIT: Stop the interpreter.
+// The instruction repeats itself forever, which run() recognizes as a wait loop.
+void Chip8::halt() {
+    pc -= 2;
+}
+
+// LOW: Switch to the 64x32 lo-res mode.
+void Chip8::lores() {
+    display.set_hires(false);
+}
+
+// HIGH: Switch to the 128x64 hi-res mode.
+void Chip8::hires() {
+    display.set_hires(true);
+}
+
+// LD HF, Vx: Set I = location of the 10 byte sprite for digit Vx.
+void Chip8::set_i_big(int x) {
+    I = memory.big_sprites_offset + (regs[x] & 0xF) * 10;
+}
+
+// LD R, Vx: Store registers V0 through Vx in the flag registers.
+void Chip8::save_flags(int x) {
+    for (auto index = 0; index <= x; index++) {
+        flags[index] = regs[index];
+    }
+}
+
+// LD Vx, R: Read registers V0 through Vx from the flag registers.
+void Chip8::load_flags(int x) {
+    for (auto index = 0; index <= x; index++) {
+        regs[index] = flags[index];
+    }
+}
+
+// SCU nibble: Scroll the display up by n pixels.
+void Chip8::scroll_up(int n) {
+    display.scroll_up(n);
+}
+
+// SAVE Vx - Vy: Store registers Vx through Vy in memory starting at location I, in reverse
+// order if x > y. I is not changed.
+void Chip8::save_range(int x, int y) {
+    auto step = x <= y ? 1 : -1;
+    auto address = I;
+    for (auto index = x;; index += step) {
+        write_memory(address++ & 0xFFFF, regs[index]);
+        if (index == y) {
+            break;
+        }
+    }
+}
+
+// LOAD Vx - Vy: Read registers Vx through Vy from memory starting at location I, in reverse
+// order if x > y. I is not changed.
+void Chip8::load_range(int x, int y) {
+    auto step = x <= y ? 1 : -1;
+    auto address = I;
+    for (auto index = x;; index += step) {
+        regs[index] = read_memory(address++ & 0xFFFF);
+        if (index == y) {
+            break;
+        }
+    }
+}
+
+// LD I, long NNNN: Set I = the 16 bit address in the following two bytes, and skip them.
+void Chip8::ld_long() {
+    I = read_memory(pc) << 8 | read_memory((pc + 1) & 0xFFFF);
+    pc += 2;
+}
+
+// PLANE n: Select the bitplanes that drawing, clearing and scrolling apply to.
+void Chip8::plane(int n) {
+    display.select_planes(n);
+}
+
+// AUDIO: Load the 16 byte audio pattern from memory starting at location I.
+void Chip8::audio() {
+    for (auto index = 0; index < 0x10; index++) {
+        audio_pattern[index] = read_memory((I + index) & 0xFFFF);
+    }
+}
+
+// PITCH Vx: Set the playback rate of the audio pattern = Vx.
+void Chip8::ld_pitch(int x) {
+    pitch = regs[x];
 }
\ No newline at end of file
@@ -1,35 +1,154 @@
 #pragma once
 
+#include <memory>
 #include <string>
 
+#include "clock.h"
 #include "display.h"
+#include "executor.h"
+#include "idle.h"
+#include "instruction.h"
 #include "keypad.h"
 #include "memory.h"
+#include "movie.h"
+#include "random.h"
+#include "state.h"
+#include "variant.h"
+
+// The guest state is inherited from MachineState, so that it can be saved and restored as a
+// single block.
+class Chip8 : private MachineState {
+    friend class Batch;
+    friend class BlockExecutor;
+    friend class JitExecutor;
+    friend class StaticExecutor;
+    friend struct StaticCode;
 
-class Chip8 {
    public:
     void reset();
     void load_rom(std::string filename);
+    void load_rom(const Rom& rom);
     void update_delay_timer();
     bool update_sound_timer();
     void set_key(int key, int val);
+
+    // Returns the pressed keys, key 0 in the lowest bit.
+    uint16_t get_keys() const {
+        return keypad.state();
+    }
     void tick();
+    void run(int cycles);
+    void run_frame(Clock::Frame frame);
+    void set_execution_mode(ExecutionMode mode);
+
+    // Records every key transition into the movie until called with nullptr.
+    void record(Movie* movie);
+
+    // Seeds the random number generator. The seed is kept across resets.
+    void seed(uint64_t value);
+
+    uint64_t get_seed() const {
+        return seed_value;
+    }
+
+    // Selects the machine to emulate. The variant is kept across resets and takes full effect
+    // with the next reset, which loads the large font of SUPER-CHIP and XO-CHIP.
+    void set_variant(Variant value);
+
+    Variant get_variant() const {
+        return variant;
+    }
+
+    // Returns the number of instructions run through run() since the reset.
+    uint64_t get_cycles() const {
+        return cycle_count;
+    }
+
+    // Turns skipping of wait loops in run() on or off. It is on by default and does not change
+    // the results, only how many instructions actually run, which matters to benchmarks.
+    void set_idle_skipping(bool enabled);
+
+    // Returns the number of instructions that were skipped in wait loops instead of being run.
+    // Not part of the machine state.
+    uint64_t get_idle_cycles() const {
+        return idle_count;
+    }
+
+    void save(MachineState& state) const;
+    void load(const MachineState& state);
+
+    // XO-CHIP machines keep their memory above 4 KB in an ExtendedState, which is saved and
+    // loaded in addition to the MachineState. The other variants have none and ignore it.
+    bool has_extended_state() const {
+        return extended != nullptr;
+    }
+    void save(ExtendedState& state) const;
+    void load(const ExtendedState& state);
 
-    uint8_t get_pixel(int i);
+    // Returns whether the beeper sounds, which it does while the sound timer is active.
+    bool sound_on() const {
+        return sound_timer > 0;
+    }
+
+    uint64_t get_row(int y);
+    const Display& get_display() const;
 
    private:
-    std::array<uint8_t, 0x10> regs = {0};
-    std::array<uint16_t, 0x10> stack = {0};
+    uint64_t seed_value = prng::default_seed;
+    Variant variant = Variant::Chip8;
+    ExecutionMode mode = ExecutionMode::Interpreter;
+    Movie* recording = nullptr;
+    uint64_t idle_count = 0;
+
+    // Instructions run between checks for a wait loop, counted across calls of run()
+    static constexpr int idle_check_interval = 64;
+    int unchecked = 0;
+    int wait_period = 0;  // Length of the wait loop found by the last check, or 0
+    bool idle_skipping = true;
+
+    // Memory above 4 KB, only allocated for XO-CHIP
+    std::unique_ptr<ExtendedState> extended;
+
+    // Predecoded instructions, indexed by address
+    std::array<Instruction, 0x1000> icache = {};
+    static const std::array<Instruction::Handler, op_count> handlers;
+
+    // Optional replacement for the tick loop in run()
+    std::unique_ptr<Executor> executor;
+
+    static Instruction decode(int opcode, Variant variant = Variant::Chip8);
+    Instruction fetch(int address) const;
+    int waiting() const;
+    void skip();
+    void write_memory(int address, uint8_t value);
+    void invalidate(int address);
 
-    uint16_t I = {0};   // Index register
-    uint16_t pc = {0};  // Program counter
-    uint16_t sp = {0};  // Stack pointer
-    uint8_t delay_timer = 0;
-    uint8_t sound_timer = 0;
+    // Reads a byte at an address that was masked with address_mask().
+    uint8_t read_memory(int address) const {
+        return address < Memory::size() ? memory[address] : extended->memory[address - Memory::size()];
+    }
 
-    Memory memory;
-    Display display;
-    Keypad keypad;
+    // Returns the mask of addresses, 4 KB or the 64 KB of XO-CHIP.
+    int address_mask() const {
+        return variant == Variant::XoChip ? 0xFFFF : 0xFFF;
+    }
+
+    // Adapters from the uniform handler signature to the instructions below
+    static void nop(Chip8&, const Instruction&) {}
+    template <void (Chip8::*F)()>
+    static void op(Chip8& chip8, const Instruction&) { (chip8.*F)(); }
+    template <void (Chip8::*F)(int)>
+    static void op_nnn(Chip8& chip8, const Instruction& ins) { (chip8.*F)(ins.nnn); }
+    template <void (Chip8::*F)(int)>
+    static void op_x(Chip8& chip8, const Instruction& ins) { (chip8.*F)(ins.x); }
+    template <void (Chip8::*F)(int)>
+    static void op_n(Chip8& chip8, const Instruction& ins) { (chip8.*F)(ins.n); }
+    template <void (Chip8::*F)(int, int)>
+    static void op_xy(Chip8& chip8, const Instruction& ins) { (chip8.*F)(ins.x, ins.y); }
+    template <void (Chip8::*F)(int, int)>
+    static void op_xkk(Chip8& chip8, const Instruction& ins) { (chip8.*F)(ins.x, ins.kk); }
+    template <void (Chip8::*F)(int, int, int)>
+    static void op_xyn(Chip8& chip8, const Instruction& ins) { (chip8.*F)(ins.x, ins.y, ins.n); }
 
     // Instructions
 
@@ -67,4 +186,27 @@ class Chip8 {
     void bcd(int x);
     void cpy_regs_to_mem(int x);
     void cpy_mem_to_regs(int x);
+    void drw_planes(int x, int y, int n);
+
+    // SUPER-CHIP instructions
+
+    void scroll_down(int n);
+    void scroll_right();
+    void scroll_left();
+    void halt();
+    void lores();
+    void hires();
+    void set_i_big(int x);
+    void save_flags(int x);
+    void load_flags(int x);
+
+    // XO-CHIP instructions
+
+    void scroll_up(int n);
+    void save_range(int x, int y);
+    void load_range(int x, int y);
+    void ld_long();
+    void plane(int n);
+    void audio();
+    void ld_pitch(int x);
 };
\ No newline at end of file
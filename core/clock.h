@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Divides emulated time into frames. Each frame gets the CPU cycles and 60 Hz timer ticks that
+// fall into it, so the CPU clock and the timers stay independent of the frame rate.
+class Clock {
+   public:
+    static constexpr int timer_hz = 60;
+
+    struct Frame {
+        int cycles;
+        int timer_ticks;
+    };
+
+    explicit Clock(int cpu_hz = 600, double fps = 60.0)
+        : cpu_hz(cpu_hz), fps(fps), frame_rate(std::max<int64_t>(1, std::llround(fps * rate_scale))) {}
+
+    // Advances emulated time by one frame. The rest of each division is carried in integers,
+    // so every second of frames gets exactly cpu_hz cycles and timer_hz ticks.
+    Frame next_frame() {
+        cycle_rest += static_cast<int64_t>(cpu_hz) * rate_scale;
+        timer_rest += static_cast<int64_t>(timer_hz) * rate_scale;
+        Frame frame{static_cast<int>(cycle_rest / frame_rate), static_cast<int>(timer_rest / frame_rate)};
+        cycle_rest %= frame_rate;
+        timer_rest %= frame_rate;
+        return frame;
+    }
+
+    int get_cpu_hz() const {
+        return cpu_hz;
+    }
+
+    double get_fps() const {
+        return fps;
+    }
+
+   private:
+    // Frame rates are exact to a thousandth of a frame per second
+    static constexpr int64_t rate_scale = 1000;
+
+    int cpu_hz;
+    double fps;
+    int64_t frame_rate;  // fps * rate_scale
+    int64_t cycle_rest = 0;
+    int64_t timer_rest = 0;
+};
@@ -1,19 +1,236 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 
-class Display {
+#include "access.h"
+
+// Framebuffer of up to 128x64 pixels in two bitplanes, with one bit per pixel and plane. Each
+// row of a plane is packed into 128 bits with the leftmost pixel in the most significant bit,
+// so drawing and scrolling are shifts of two words.
+//
+// In lo-res mode the screen is 64x32 and uses the top left quarter of the planes: row y of
+// plane 0 is the high word of its packed row, exactly the layout of the original 64x32
+// display. Hi-res mode uses all of it.
+template <typename Access = DefaultAccess>
+class BasicDisplay {
    public:
-    static constexpr int m_width = 64;
-    static constexpr int m_height = 32;
-    static constexpr int scale = 10;
+    static constexpr int m_width = 128;
+    static constexpr int m_height = 64;
+    static constexpr int planes = 2;
+    static constexpr int scale = 5;
+
+    // A row of 128 pixels of one plane
+    struct Row {
+        uint64_t hi;  // Pixels 0 to 63
+        uint64_t lo;  // Pixels 64 to 127
+
+        bool bit(int x) const {
+            return x < 64 ? (hi >> (63 - x)) & 1 : (lo >> (127 - x)) & 1;
+        }
+
+        bool operator==(const Row& other) const {
+            return hi == other.hi && lo == other.lo;
+        }
+    };
 
+    // Clears all planes and returns to lo-res mode with plane 0 selected.
+    void reset() {
+        rows = {};
+        hires = false;
+        selected = 1;
+    }
+
+    // Clears the selected planes. In lo-res mode only the pixels of the lo-res screen can be
+    // set, so only those are cleared.
     void clear() {
-        data.fill(0);
+        for (auto plane = 0; plane < planes; plane++) {
+            if ((selected & (1 << plane)) == 0) {
+                continue;
+            }
+            if (hires) {
+                rows[plane] = {};
+                continue;
+            }
+            for (auto y = 0; y < m_height / 2; y++) {
+                rows[plane][y].hi = 0;
+            }
+        }
+    }
+
+    // Switches between 64x32 and 128x64. The screen is cleared.
+    void set_hires(bool enabled) {
+        hires = enabled;
+        rows = {};
+    }
+
+    bool is_hires() const {
+        return hires;
+    }
+
+    int active_width() const {
+        return hires ? m_width : m_width / 2;
+    }
+
+    int active_height() const {
+        return hires ? m_height : m_height / 2;
+    }
+
+    // Selects the planes that drawing, clearing and scrolling apply to, one bit per plane.
+    void select_planes(int mask) {
+        selected = static_cast<uint8_t>(mask & 0x3);
+    }
+
+    int selected_planes() const {
+        return selected;
+    }
+
+    // Returns a lo-res row of plane 0.
+    uint64_t row(int y) const {
+        return Access::at(rows[0], y).hi;
+    }
+
+    const Row& line(int plane, int y) const {
+        return Access::at(rows[plane & 1], y);
+    }
+
+    // Returns the packed planes for reading in place: plane 0 then plane 1, each m_height rows
+    // of two words, the hi word first.
+    const uint64_t* words() const {
+        static_assert(sizeof(Row) == 2 * sizeof(uint64_t), "Rows must be packed");
+        return &rows[0][0].hi;
+    }
+
+    // Returns the plane bits of a pixel in screen coordinates, plane 0 in the lowest bit.
+    int color(int x, int y) const {
+        return line(0, y).bit(x) | line(1, y).bit(x) << 1;
+    }
+
+    // XORs the given pixels onto a lo-res row of plane 0. Returns whether any pixel was erased.
+    bool xor_row(int y, uint64_t pixels) {
+        auto& row = Access::at(rows[0], y).hi;
+        auto collision = (row & pixels) != 0;
+        row ^= pixels;
+        return collision;
     }
 
-    uint8_t& operator[](int index) {
-        return data.at(index);
+    // XORs an 8 pixel wide sprite row onto plane 0 of the lo-res screen with its leftmost pixel
+    // at (x, y). Pixels past the edges wrap around to the opposite side. Returns whether any
+    // pixel was erased.
+    bool draw(int x, int y, uint8_t sprite) {
+        x %= 64;
+        auto leftmost = static_cast<uint64_t>(sprite) << 56;
+        auto pixels = (leftmost >> x) | (leftmost << ((64 - x) & 63));
+        return xor_row(y % 32, pixels);
+    }
+
+    // XORs a sprite row of the given width, its leftmost pixel in the highest bit, onto one
+    // plane at (x, y) in the current resolution. Pixels past the edges wrap around. Returns
+    // whether any pixel was erased.
+    bool draw(int plane, int x, int y, uint16_t sprite, int width) {
+        auto screen = active_width();
+        x %= screen;
+        Row pixels = {static_cast<uint64_t>(sprite) << (64 - width), 0};
+        if (screen == 64) {
+            pixels.hi = (pixels.hi >> x) | (pixels.hi << ((64 - x) & 63));
+        } else {
+            pixels = rotate_right(pixels, x);
+        }
+        auto& row = Access::at(rows[plane & 1], y % active_height());
+        auto collision = (row.hi & pixels.hi) != 0 || (row.lo & pixels.lo) != 0;
+        row.hi ^= pixels.hi;
+        row.lo ^= pixels.lo;
+        return collision;
+    }
+
+    // Scrolls the selected planes by n pixels. Pixels scrolled in are off.
+    void scroll_down(int n) {
+        scroll_rows(n);
+    }
+
+    void scroll_up(int n) {
+        scroll_rows(-n);
+    }
+
+    void scroll_right(int n) {
+        if (n <= 0 || n >= 64) {
+            return;
+        }
+        auto wide = hires;
+        each_selected_row([n, wide](Row& row) {
+            row.lo = wide ? (row.lo >> n) | (row.hi << (64 - n)) : 0;
+            row.hi >>= n;
+        });
+    }
+
+    void scroll_left(int n) {
+        if (n <= 0 || n >= 64) {
+            return;
+        }
+        auto wide = hires;
+        each_selected_row([n, wide](Row& row) {
+            row.hi = wide ? (row.hi << n) | (row.lo >> (64 - n)) : row.hi << n;
+            row.lo = wide ? row.lo << n : 0;
+        });
+    }
+
+    // Expands the screen into 32 bit colors, m_width by m_height with lo-res pixels doubled.
+    // The palette is indexed by the plane bits of a pixel, the pitch is in pixels.
+    void expand(uint32_t* pixels, std::ptrdiff_t pitch, const std::array<uint32_t, 4>& palette) const {
+        auto size = m_width / active_width();
+        auto words = active_width() / 64;
+        for (auto y = 0; y < active_height(); y++) {
+            auto out = pixels + y * size * pitch;
+            auto x = 0;
+            for (auto word = 0; word < words; word++) {
+                auto plane0 = word == 0 ? rows[0][y].hi : rows[0][y].lo;
+                auto plane1 = word == 0 ? rows[1][y].hi : rows[1][y].lo;
+                for (auto bit = 63; bit >= 0; bit--) {
+                    auto color = palette[((plane0 >> bit) & 1) | ((plane1 >> bit) & 1) << 1];
+                    for (auto i = 0; i < size; i++) {
+                        out[x++] = color;
+                    }
+                }
+            }
+            for (auto i = 1; i < size; i++) {
+                std::memcpy(out + i * pitch, out, m_width * sizeof(uint32_t));
+            }
+        }
+    }
+
+    // Rows are plain words without padding, so they compare as one block of memory.
+    bool operator==(const BasicDisplay& other) const {
+        return hires == other.hires && std::memcmp(rows.data(), other.rows.data(), sizeof(rows)) == 0;
+    }
+
+    bool operator!=(const BasicDisplay& other) const {
+        return !(*this == other);
+    }
+
+    // Returns a FNV-1a hash of the screen. Plane 1 only counts once it has a pixel, so a
+    // lo-res screen in plane 0 hashes the same as the original 64x32 display.
+    uint64_t hash() const {
+        uint64_t hash = 0xcbf29ce484222325;
+        auto add = [&hash](uint64_t word) {
+            for (auto i = 0; i < 8; i++) {
+                hash = (hash ^ ((word >> (i * 8)) & 0xFF)) * 0x100000001b3;
+            }
+        };
+        for (auto plane = 0; plane < planes; plane++) {
+            if (plane > 0 && empty(plane)) {
+                continue;
+            }
+            for (auto y = 0; y < active_height(); y++) {
+                add(rows[plane][y].hi);
+                if (hires) {
+                    add(rows[plane][y].lo);
+                }
+            }
+        }
+        return hash;
     }
 
     static constexpr int width() {
@@ -24,6 +241,67 @@ class Display {
         return m_height * scale;
     }
 
-    private:
-    std::array<uint8_t, m_width * m_height> data = {0};
-};
\ No newline at end of file
+   private:
+    std::array<std::array<Row, m_height>, planes> rows = {};
+    bool hires = false;
+    uint8_t selected = 1;
+
+    bool empty(int plane) const {
+        for (auto& row : rows[plane]) {
+            if ((row.hi | row.lo) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static Row rotate_right(Row row, int n) {
+        if (n >= 64) {
+            row = {row.lo, row.hi};
+            n -= 64;
+        }
+        if (n == 0) {
+            return row;
+        }
+        return {(row.hi >> n) | (row.lo << (64 - n)), (row.lo >> n) | (row.hi << (64 - n))};
+    }
+
+    // Moves the rows of the selected planes down by n, or up for a negative n.
+    void scroll_rows(int n) {
+        auto height = active_height();
+        if (n == 0 || n >= height || -n >= height) {
+            if (n != 0) {
+                clear();
+            }
+            return;
+        }
+        for (auto plane = 0; plane < planes; plane++) {
+            if ((selected & (1 << plane)) == 0) {
+                continue;
+            }
+            auto first = rows[plane].begin();
+            auto last = first + height;
+            if (n > 0) {
+                std::copy_backward(first, last - n, last);
+                std::fill(first, first + n, Row{});
+            } else {
+                std::copy(first - n, last, first);
+                std::fill(last + n, last, Row{});
+            }
+        }
+    }
+
+    template <typename F>
+    void each_selected_row(F f) {
+        for (auto plane = 0; plane < planes; plane++) {
+            if ((selected & (1 << plane)) == 0) {
+                continue;
+            }
+            for (auto y = 0; y < active_height(); y++) {
+                f(rows[plane][y]);
+            }
+        }
+    }
+};
+
+using Display = BasicDisplay<>;
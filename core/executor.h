@@ -0,0 +1,26 @@
+#pragma once
+
+class Chip8;
+
+enum class ExecutionMode {
+    Interpreter,  // Chip8::tick per instruction, the reference
+    Blocks,       // Threaded basic blocks, see BlockExecutor
+    Jit,          // Native x86-64 code, see JitExecutor
+    Static,       // Code compiled ahead of time with chip8_recompile, see StaticExecutor
+};
+
+// Runs instructions on behalf of a Chip8 as an alternative to calling tick() in a loop.
+// Executors keep translated code, which has to be dropped when the guest writes to it.
+class Executor {
+   public:
+    virtual ~Executor() = default;
+
+    // Runs exactly the given number of instructions.
+    virtual void run(Chip8& chip8, int cycles) = 0;
+
+    // Drops translated code that contains the byte at the given address.
+    virtual void invalidate(int address) = 0;
+
+    // Drops all translated code.
+    virtual void flush() = 0;
+};
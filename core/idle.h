@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+
+#include "instruction.h"
+
+// Longest wait loop that is recognized, in instructions
+constexpr int max_wait_loop = 16;
+
+// Returns the length in instructions of the wait loop the program counter is in, or 0 if it
+// is not in one.
+//
+// A wait loop polls the keys or the delay timer, like "ld Vx, DT; se Vx, 0; jmp" or a chain of
+// sknp, or blocks in ld_timer_wait, halt or a jump to itself. Such a loop is found by following the
+// program from the program counter with the current state. Only instructions that leave the
+// state as it is are allowed: jumps, skips, reads of the keys and loads of values that a
+// register already holds. If the program gets back to the program counter that way, every
+// further iteration does the same until a timer ticks or a key changes, which never happens
+// within a run, so any whole number of iterations can be skipped.
+//
+// Decodes the instruction at an address with fetch(address) and reads register x with V(x).
+template <typename Fetch, typename Reg>
+int wait_loop(int pc, Fetch fetch, Reg V, uint16_t I, uint8_t delay_timer, uint16_t keys) {
+    auto address = pc;
+    for (auto length = 1; length <= max_wait_loop; length++) {
+        if (address + 1 >= 0x1000) {
+            return 0;
+        }
+        auto ins = fetch(address);
+        auto next = address + 2;
+        auto skip = false;
+        switch (ins.op) {
+            case Op::nop:
+                break;
+            case Op::jmp:
+                next = ins.nnn;
+                break;
+            case Op::se_byte:
+                skip = V(ins.x) == ins.kk;
+                break;
+            case Op::sne_byte:
+                skip = V(ins.x) != ins.kk;
+                break;
+            case Op::se_reg:
+                skip = V(ins.x) == V(ins.y);
+                break;
+            case Op::sne:
+                skip = V(ins.x) != V(ins.y);
+                break;
+            case Op::skp:
+            case Op::sknp:
+                if (V(ins.x) >= 0x10) {
+                    return 0;
+                }
+                skip = ((keys >> V(ins.x)) & 1) == (ins.op == Op::skp);
+                break;
+            case Op::ld_byte:
+                if (V(ins.x) != ins.kk) {
+                    return 0;
+                }
+                break;
+            case Op::ld_reg:
+                if (V(ins.x) != V(ins.y)) {
+                    return 0;
+                }
+                break;
+            case Op::ld:
+                if (I != ins.nnn) {
+                    return 0;
+                }
+                break;
+            case Op::ld_delay_timer:
+            case Op::ld_delay_timer_set:
+                if (V(ins.x) != delay_timer) {
+                    return 0;
+                }
+                break;
+            case Op::ld_timer_wait:
+                // Repeats itself while no key below F is pressed
+                if ((keys & 0x7FFF) != 0) {
+                    return 0;
+                }
+                next = address;
+                break;
+            case Op::halt:
+                next = address;
+                break;
+            default:
+                return 0;
+        }
+        if (skip) {
+            // Long loads of I are the only four byte instructions
+            next += next + 1 < 0x1000 && fetch(next).op == Op::ld_long ? 4 : 2;
+        }
+        if (next == pc) {
+            return length;
+        }
+        address = next;
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+
+class Chip8;
+
+// Operations, named after the Chip8 member that implements them.
+enum class Op : uint8_t {
+    nop,
+    cls,
+    ret,
+    jmp,
+    call,
+    se_byte,
+    sne_byte,
+    se_reg,
+    ld_byte,
+    add_byte,
+    ld_reg,
+    fn_or,
+    fn_and,
+    fn_xor,
+    add_reg,
+    sub,
+    shr,
+    subn,
+    shl,
+    sne,
+    ld,
+    jp_reg,
+    rnd,
+    drw,
+    skp,
+    sknp,
+    ld_delay_timer,
+    ld_timer_wait,
+    ld_delay_timer_set,
+    ld_sound_timer_set,
+    add_i_reg,
+    set_i_reg,
+    bcd,
+    cpy_regs_to_mem,
+    cpy_mem_to_regs,
+
+    // SUPER-CHIP
+    scroll_down,
+    scroll_right,
+    scroll_left,
+    halt,
+    lores,
+    hires,
+    set_i_big,
+    save_flags,
+    load_flags,
+
+    // XO-CHIP
+    scroll_up,
+    save_range,
+    load_range,
+    ld_long,
+    plane,
+    audio,
+    ld_pitch,
+
+    exit,  // Never decoded, marks the end of translated code
+};
+
+constexpr int op_count = static_cast<int>(Op::exit) + 1;
+
+// A predecoded instruction: the handler that executes it and its extracted operands.
+// An instruction without a handler has not been decoded yet.
+struct Instruction {
+    using Handler = void (*)(Chip8&, const Instruction&);
+
+    Handler handler = nullptr;
+    uint16_t nnn = 0;
+    uint8_t x = 0;
+    uint8_t y = 0;
+    uint8_t n = 0;
+    uint8_t kk = 0;
+    Op op = Op::nop;
+};
+
+// Returns whether straight-line execution always stops after the instruction, either because it
+// sets the program counter or because it writes to memory that could hold code.
+constexpr bool ends_block(Op op) {
+    switch (op) {
+        case Op::ret:
+        case Op::jmp:
+        case Op::call:
+        case Op::jp_reg:
+        case Op::ld_timer_wait:  // Repeats until a key is pressed
+        case Op::halt:           // Repeats forever
+        case Op::ld_long:        // Skips its operand
+        case Op::bcd:
+        case Op::cpy_regs_to_mem:
+        case Op::save_range:
+        case Op::exit:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Returns whether the instruction conditionally skips the next one.
+constexpr bool is_skip(Op op) {
+    switch (op) {
+        case Op::se_byte:
+        case Op::sne_byte:
+        case Op::se_reg:
+        case Op::sne:
+        case Op::skp:
+        case Op::sknp:
+            return true;
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,526 @@
+#include "jit_executor.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "chip8.h"
+
+#ifdef CHIP8_JIT_X64
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+// Appends x86-64 machine code to a buffer. Guest state is addressed relative to rbx, which
+// holds the Chip8 pointer, and the I register lives in r12d for the duration of a block.
+// Host registers are numbered like in the encoding, 0 for rax to 15 for r15.
+class Emitter {
+   public:
+    explicit Emitter(uint8_t* cursor) : cursor(cursor) {}
+
+    uint8_t* cursor;
+
+    void bytes(std::initializer_list<uint8_t> values) {
+        for (auto value : values) {
+            *cursor++ = value;
+        }
+    }
+
+    template <typename T>
+    void imm(T value) {
+        std::memcpy(cursor, &value, sizeof(value));
+        cursor += sizeof(value);
+    }
+
+    // Opcode bytes followed by a [rbx + disp32] operand with the given ModRM reg field
+    void mem(std::initializer_list<uint8_t> opcode, int reg, int32_t disp) {
+        bytes(opcode);
+        bytes({static_cast<uint8_t>(0x83 | (reg << 3))});
+        imm(disp);
+    }
+
+    // REX prefix, always emitted for byte registers so that 4 to 7 are spl to dil
+    void rex(int reg, int rm) {
+        bytes({static_cast<uint8_t>(0x40 | (reg >> 3) << 2 | rm >> 3)});
+    }
+
+    // Opcode with a register-direct ModRM operand on byte registers
+    void reg8(std::initializer_list<uint8_t> opcode, int reg, int rm) {
+        rex(reg, rm);
+        bytes(opcode);
+        bytes({static_cast<uint8_t>(0xC0 | (reg & 7) << 3 | (rm & 7))});
+    }
+
+    void load8(int reg, int32_t disp) {  // mov r8, [m]
+        rex(reg, 3);
+        mem({0x8A}, reg & 7, disp);
+    }
+    void store8(int reg, int32_t disp) {  // mov [m], r8
+        rex(reg, 3);
+        mem({0x88}, reg & 7, disp);
+    }
+    void mov8(int dst, int src) { reg8({0x88}, src, dst); }  // mov dst, src
+    void mov8(int dst, uint8_t value) {                        // mov dst, imm8
+        rex(0, dst);
+        bytes({static_cast<uint8_t>(0xB0 | (dst & 7)), value});
+    }
+    // Group 1 operation (0 add, 1 or, 4 and, 5 sub, 6 xor, 7 cmp) on dst with an imm8
+    void alu8(int op, int dst, uint8_t value) {
+        reg8({0x80}, op, dst);
+        bytes({value});
+    }
+    // Group 1 operation on dst with a register
+    void alu8(int op, int dst, int src) { reg8({static_cast<uint8_t>(op << 3)}, src, dst); }
+    void shift8(bool right, int dst) { reg8({0xD0}, right ? 5 : 4, dst); }  // shr/shl dst, 1
+    void movzx_eax(int src) { reg8({0x0F, 0xB6}, 0, src); }                 // movzx eax, src
+
+    void setc_cl() { bytes({0x0F, 0x92, 0xC1}); }                // setc cl
+    void seta_cl() { bytes({0x0F, 0x97, 0xC1}); }                // seta cl
+    void load_i(int32_t disp) { mem({0x44, 0x0F, 0xB7}, 4, disp); }  // movzx r12d, word [m]
+    void store_i(int32_t disp) { mem({0x66, 0x44, 0x89}, 4, disp); } // mov [m], r12w
+
+    // mov word [m], imm16
+    void store_word(int32_t disp, uint16_t value) {
+        mem({0x66, 0xC7}, 0, disp);
+        imm(value);
+    }
+
+    // jmp rel32
+    void jmp(const uint8_t* target) {
+        bytes({0xE9});
+        imm(static_cast<int32_t>(target - (cursor + 4)));
+    }
+
+    // Leaves the block through the epilogue, reporting the given instruction count.
+    void leave(const uint8_t* epilogue, int count) {
+        bytes({0xB8});
+        imm(static_cast<int32_t>(count));
+        jmp(epilogue);
+    }
+
+    // Emits a short conditional jump over the code that the callback emits.
+    template <typename F>
+    void skip_unless(uint8_t jcc, F emit) {
+        bytes({jcc, 0});
+        auto patch = cursor - 1;
+        emit();
+        *patch = static_cast<uint8_t>(cursor - (patch + 1));
+    }
+};
+
+constexpr uint8_t je = 0x74;
+constexpr uint8_t jne = 0x75;
+
+constexpr int rax = 0;
+constexpr int rcx = 1;
+
+// Group 1 operations of alu8
+constexpr int op_add = 0;
+constexpr int op_or = 1;
+constexpr int op_and = 4;
+constexpr int op_sub = 5;
+constexpr int op_xor = 6;
+constexpr int op_cmp = 7;
+
+// Keeps the guest registers V0 to VF in host registers for the duration of a block. A register
+// is loaded on its first use and written back before every exit and handler call. The host
+// registers hold their guest register until the block leaves or calls a handler, or until
+// they are taken for another one, least recently used first.
+class RegisterCache {
+   public:
+    // rdx, rsi, rdi, r8 to r11, and the callee-saved r13 to r15
+    static constexpr std::array<int, 10> pool = {2, 6, 7, 8, 9, 10, 11, 13, 14, 15};
+
+    RegisterCache(Emitter& e, int32_t regs) : e(e), regs(regs) {}
+
+    // Starts the next instruction, whose registers are never taken from each other.
+    void next() {
+        locked = 0;
+    }
+
+    // Returns the host register holding Vx.
+    int read(int x) {
+        auto host = find(x);
+        if (host < 0) {
+            host = take(x);
+            e.load8(host, regs + x);
+        }
+        return host;
+    }
+
+    // Returns the host register holding Vx, which the caller changes.
+    int modify(int x) {
+        auto host = read(x);
+        dirty |= 1 << x;
+        return host;
+    }
+
+    // Returns a host register for Vx, which the caller overwrites without reading it.
+    int write(int x) {
+        auto host = find(x);
+        if (host < 0) {
+            host = take(x);
+        }
+        dirty |= 1 << x;
+        return host;
+    }
+
+    // Writes the changed registers back to the guest state. They stay cached, so that code
+    // on an exit path can call it without affecting the code after it.
+    void store() const {
+        for (std::size_t i = 0; i < pool.size(); i++) {
+            if (guest[i] >= 0 && (dirty >> guest[i] & 1)) {
+                e.store8(pool[i], regs + guest[i]);
+            }
+        }
+    }
+
+    // Writes back and forgets every register, before a handler reads or changes the state.
+    void flush() {
+        store();
+        guest.fill(-1);
+        dirty = 0;
+    }
+
+   private:
+    Emitter& e;
+    int32_t regs;
+    std::array<int, pool.size()> guest = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+    std::array<int, pool.size()> used = {};
+    int dirty = 0;   // Guest registers changed since they were loaded, bit x for Vx
+    int locked = 0;  // Guest registers of the current instruction
+    int clock = 0;
+
+    int find(int x) {
+        for (std::size_t i = 0; i < pool.size(); i++) {
+            if (guest[i] == x) {
+                used[i] = ++clock;
+                locked |= 1 << x;
+                return pool[i];
+            }
+        }
+        return -1;
+    }
+
+    // Takes a free or the least recently used host register, writing back what it held.
+    int take(int x) {
+        std::size_t victim = 0;
+        for (std::size_t i = 0; i < pool.size(); i++) {
+            if (guest[i] < 0) {
+                victim = i;
+                break;
+            }
+            if ((locked >> guest[i] & 1) == 0 &&
+                ((locked >> guest[victim] & 1) != 0 || used[i] < used[victim])) {
+                victim = i;
+            }
+        }
+        auto old = guest[victim];
+        if (old >= 0 && (dirty >> old & 1)) {
+            e.store8(pool[victim], regs + old);
+        }
+        if (old >= 0) {
+            dirty &= ~(1 << old);
+        }
+        guest[victim] = x;
+        used[victim] = ++clock;
+        locked |= 1 << x;
+        return pool[victim];
+    }
+};
+
+}  // namespace
+
+JitExecutor::JitExecutor() {
+#ifdef CHIP8_JIT_X64
+    auto memory = mmap(nullptr, code_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory != MAP_FAILED) {
+        buffer = static_cast<uint8_t*>(memory);
+        writable = true;
+    }
+#endif
+    instructions.reserve(max_instructions + max_length);
+    flush();
+}
+
+JitExecutor::~JitExecutor() {
+    release();
+}
+
+// Switches the code memory between writable and executable. Returns false if the host
+// refused, for example under a policy that forbids making written memory executable.
+bool JitExecutor::protect(bool write) {
+#ifdef CHIP8_JIT_X64
+    if (write == writable) {
+        return true;
+    }
+    if (mprotect(buffer, code_size, write ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) != 0) {
+        return false;
+    }
+    writable = write;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Gives up the code memory, after which every instruction is interpreted.
+void JitExecutor::release() {
+#ifdef CHIP8_JIT_X64
+    if (buffer != nullptr) {
+        munmap(buffer, code_size);
+        buffer = nullptr;
+    }
+#endif
+    blocks.fill({});
+}
+
+bool JitExecutor::available() {
+#ifdef CHIP8_JIT_X64
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Runs compiled blocks while the budget allows it and interprets the remaining instructions.
+void JitExecutor::run(Chip8& chip8, int cycles) {
+    while (cycles > 0) {
+        auto block = lookup(chip8);
+        if (block == nullptr || block->length > cycles) {
+            chip8.tick();
+            cycles--;
+            continue;
+        }
+        cycles -= block->code(&chip8);
+    }
+}
+
+// Drops every block that contains the byte at the given address. The code itself stays in
+// the buffer until the next flush, so a block may safely return after invalidating itself.
+void JitExecutor::invalidate(int address) {
+    address &= 0xFFF;
+    if (!covered[address]) {
+        return;
+    }
+    for (auto start = std::max(0, address - 2 * max_length); start <= address; start++) {
+        auto& block = blocks[start];
+        if (block.code != nullptr && address < start + 2 * block.length) {
+            block = {};
+        }
+    }
+}
+
+void JitExecutor::flush() {
+    blocks.fill({});
+    covered.reset();
+    instructions.clear();
+    used = 0;
+}
+
+// Returns the block starting at the program counter, compiling it on first use.
+// Returns nullptr if there is no executable memory or no complete instruction at the program
+// counter.
+const JitExecutor::Block* JitExecutor::lookup(Chip8& chip8) {
+    if (buffer == nullptr || chip8.pc + 1 >= static_cast<int>(blocks.size())) {
+        return nullptr;
+    }
+    auto block = &blocks[chip8.pc];
+    if (block->code == nullptr) {
+        translate(chip8, chip8.pc);
+        if (block->code == nullptr) {
+            return nullptr;
+        }
+    }
+    return block;
+}
+
+JitExecutor::Offsets JitExecutor::offsets(Chip8& chip8) {
+    auto base = reinterpret_cast<char*>(&chip8);
+    return {
+        static_cast<int32_t>(reinterpret_cast<char*>(chip8.regs.data()) - base),
+        static_cast<int32_t>(reinterpret_cast<char*>(&chip8.I) - base),
+        static_cast<int32_t>(reinterpret_cast<char*>(&chip8.pc) - base),
+    };
+}
+
+// Compiles the block starting at the given address. The generated function starts with its
+// own epilogue, so that every exit can jump back to it:
+//
+//   epilogue: store I, restore callee-saved registers, return the count in eax
+//   entry:    save callee-saved registers, rbx = chip8, r12d = I, then the instructions
+//
+// V0 to VF are kept in host registers by a RegisterCache, every exit writes them back before
+// it jumps to the epilogue.
+void JitExecutor::translate(Chip8& chip8, int start) {
+    // Worst case size of one instruction, generously rounded up
+    constexpr std::size_t max_instruction_size = 160;
+    if (used + (max_length + 2) * max_instruction_size > code_size ||
+        instructions.size() + max_length > max_instructions) {
+        flush();
+    }
+    if (!protect(true)) {
+        release();
+        return;
+    }
+
+    auto off = offsets(chip8);
+
+    Emitter e(buffer + used);
+    RegisterCache v(e, off.regs);
+
+    auto epilogue = e.cursor;
+    e.store_i(off.I);
+    e.bytes({0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3});  // pop r15 to r12; pop rbx; ret
+
+    auto entry = e.cursor;
+    e.bytes({0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57});  // push rbx; push r12 to r15
+    e.bytes({0x48, 0x89, 0xFB});                                      // mov rbx, rdi
+    e.load_i(off.I);
+
+    // Leaves the block with the given pc and instruction count.
+    auto leave = [&](uint16_t pc, int count) {
+        v.store();
+        e.store_word(off.pc, pc);
+        e.leave(epilogue, count);
+    };
+
+    auto& block = blocks[start];
+    block.length = 0;
+
+    auto address = start;
+    auto done = false;
+    while (!done && address + 1 < static_cast<int>(blocks.size()) && block.length < max_length) {
+        auto ins = Chip8::decode(chip8.memory[address] << 8 | chip8.memory[address + 1], chip8.variant);
+        covered[address] = true;
+        covered[address + 1] = true;
+        block.length++;
+        v.next();
+
+        auto next = static_cast<uint16_t>(address + 2);
+        auto count = block.length;
+        auto x = ins.x;
+        auto y = ins.y;
+        auto flags_free = x != 0xF && y != 0xF;
+
+        // Leaves the block with pc at the instruction after the skipped one.
+        auto skip_exit = [&] { leave(next + 2, count); };
+
+        switch (ins.op) {
+            case Op::nop:
+                break;
+            case Op::jmp:
+                leave(ins.nnn, count);
+                done = true;
+                break;
+            case Op::se_byte:
+            case Op::sne_byte:
+                e.alu8(op_cmp, v.read(x), ins.kk);
+                e.skip_unless(ins.op == Op::se_byte ? jne : je, skip_exit);
+                break;
+            case Op::se_reg:
+            case Op::sne: {
+                auto vx = v.read(x);
+                e.alu8(op_cmp, vx, v.read(y));
+                e.skip_unless(ins.op == Op::se_reg ? jne : je, skip_exit);
+                break;
+            }
+            case Op::ld_byte:
+                e.mov8(v.write(x), ins.kk);
+                break;
+            case Op::add_byte:
+                e.alu8(op_add, v.modify(x), ins.kk);
+                break;
+            case Op::ld_reg: {
+                auto vy = v.read(y);
+                e.mov8(v.write(x), vy);
+                break;
+            }
+            case Op::fn_or:
+            case Op::fn_and:
+            case Op::fn_xor: {
+                auto vy = v.read(y);
+                e.alu8(ins.op == Op::fn_or ? op_or : ins.op == Op::fn_and ? op_and : op_xor, v.modify(x), vy);
+                break;
+            }
+            case Op::ld:
+                e.bytes({0x41, 0xBC});  // mov r12d, nnn
+                e.imm(static_cast<uint32_t>(ins.nnn));
+                break;
+            case Op::add_i_reg:
+                e.movzx_eax(v.read(x));
+                e.bytes({0x41, 0x01, 0xC4});        // add r12d, eax
+                e.bytes({0x45, 0x0F, 0xB7, 0xE4});  // movzx r12d, r12w
+                break;
+            case Op::set_i_reg:
+                e.movzx_eax(v.read(x));
+                e.bytes({0x44, 0x8D, 0x24, 0x80});  // lea r12d, [rax + rax * 4]
+                break;
+            case Op::add_reg:
+            case Op::sub:
+            case Op::subn:
+            case Op::shr:
+            case Op::shl:
+                if (flags_free) {
+                    if (ins.op == Op::add_reg) {
+                        auto vy = v.read(y);
+                        e.alu8(op_add, v.modify(x), vy);
+                        e.setc_cl();
+                    } else if (ins.op == Op::sub) {
+                        auto vy = v.read(y);
+                        e.alu8(op_sub, v.modify(x), vy);
+                        e.seta_cl();
+                    } else if (ins.op == Op::subn) {
+                        auto vx = v.modify(x);
+                        e.mov8(rax, v.read(y));
+                        e.alu8(op_sub, rax, vx);
+                        e.seta_cl();
+                        e.mov8(vx, rax);
+                    } else {
+                        e.shift8(ins.op == Op::shr, v.modify(x));
+                        e.setc_cl();
+                    }
+                    e.mov8(v.write(0xF), rcx);
+                    break;
+                }
+                [[fallthrough]];
+            default:
+                // Call the interpreter handler with the guest state in memory
+                v.flush();
+                instructions.push_back(ins);
+                e.store_word(off.pc, next);
+                e.store_i(off.I);
+                e.bytes({0x48, 0x89, 0xDF});  // mov rdi, rbx
+                e.bytes({0x48, 0xBE});        // mov rsi, &instruction
+                e.imm(&instructions.back());
+                e.bytes({0x48, 0xB8});  // mov rax, handler
+                e.imm(ins.handler);
+                e.bytes({0xFF, 0xD0});  // call rax
+                e.load_i(off.I);
+                if (is_skip(ins.op)) {
+                    e.mem({0x66, 0x81}, 7, off.pc);  // cmp word [pc], next
+                    e.imm(next);
+                    e.skip_unless(je, [&] { e.leave(epilogue, count); });
+                }
+                // Handlers that end the block have set pc
+                done = ends_block(ins.op);
+                if (done) {
+                    e.leave(epilogue, count);
+                }
+                break;
+        }
+
+        address = next;
+    }
+
+    // Fell off the end of a block that was cut short
+    if (!done) {
+        leave(address, block.length);
+    }
+
+    block.code = reinterpret_cast<Code>(entry);
+    used = e.cursor - buffer;
+    if (!protect(false)) {
+        release();
+    }
+}
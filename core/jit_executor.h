@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+#include "executor.h"
+#include "instruction.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define CHIP8_JIT_X64 1
+#endif
+
+// Translates basic blocks into native x86-64 code. Registers, ALU, jump and skip instructions
+// are compiled inline, everything else (drw, keys, timers, the stack) calls the interpreter
+// handler of the instruction. V0 to VF and I stay in host registers within a block and are
+// written back when it leaves or calls a handler. Blocks are split like in BlockExecutor. Without an x86-64 host
+// or executable memory, every instruction is interpreted.
+class JitExecutor : public Executor {
+   public:
+    static constexpr int max_length = 32;
+
+    JitExecutor();
+    ~JitExecutor() override;
+
+    JitExecutor(const JitExecutor&) = delete;
+    JitExecutor& operator=(const JitExecutor&) = delete;
+
+    // Returns whether native code can be generated on this host.
+    static bool available();
+
+    void run(Chip8& chip8, int cycles) override;
+    void invalidate(int address) override;
+    void flush() override;
+
+   private:
+    // Compiled block, returns the number of instructions it ran
+    using Code = int (*)(Chip8*);
+
+    static constexpr std::size_t code_size = 0x100000;
+    static constexpr std::size_t max_instructions = 0x4000;
+
+    struct Block {
+        Code code = nullptr;  // nullptr if not translated
+        uint16_t length = 0;
+    };
+
+    struct Offsets {
+        int32_t regs;
+        int32_t I;
+        int32_t pc;
+    };
+
+    std::array<Block, 0x1000> blocks;
+    std::bitset<0x1000> covered;  // Bytes that belong to any translated block
+
+    // Code memory, never writable and executable at the same time: it is only made writable
+    // while a block is emitted
+    uint8_t* buffer = nullptr;
+    std::size_t used = 0;
+    bool writable = false;
+
+    // Instructions that compiled code passes to interpreter handlers. Never reallocated.
+    std::vector<Instruction> instructions;
+
+    bool protect(bool write);
+    void release();
+    const Block* lookup(Chip8& chip8);
+    void translate(Chip8& chip8, int start);
+    static Offsets offsets(Chip8& chip8);
+};
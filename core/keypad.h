@@ -1,39 +1,52 @@
 #pragma once
 
-#include <array>
+#include <cstdint>
 
-class Keypad {
+#include "access.h"
+
+// State of the 16 keys of the hex keypad, one bit per key, so that testing a key is a single
+// shift and mask.
+template <typename Access = DefaultAccess>
+class BasicKeypad {
    public:
-    uint8_t& operator[](uint8_t index) {
-        return keyboard.at(index);
+    void set(int key, bool pressed) {
+        auto bit = static_cast<uint16_t>(1u << Access::template index<0x10>(key));
+        keys = pressed ? keys | bit : keys & ~bit;
+    }
+
+    bool is_pressed(int key) const {
+        return (keys >> Access::template index<0x10>(key)) & 1;
     }
 
-    bool is_pressed(uint8_t key) {
-        return keyboard.at(keymap.at(key)) == 1;
+    // Returns the highest pressed key among the keys in the mask, or -1 if none of them is
+    // pressed.
+    int highest_pressed(uint16_t mask = 0xFFFF) const {
+        unsigned pressed = keys & mask;
+        if (pressed == 0) {
+            return -1;
+        }
+#if defined(__GNUC__) || defined(__clang__)
+        return 31 - __builtin_clz(pressed);
+#else
+        auto key = 0;
+        while (pressed >>= 1) {
+            key++;
+        }
+        return key;
+#endif
+    }
+
+    // Returns the pressed keys, key 0 in the lowest bit.
+    uint16_t state() const {
+        return keys;
     }
 
     void reset() {
-        keyboard.fill(0);
+        keys = 0;
     }
 
    private:
-    std::array<uint8_t, 0xFF> keyboard = {0};
-    std::array<uint8_t, 0x10> keymap = {
-        0x78,  // X (C8: 0)
-        0x31,  // 1 (C8: 1)
-        0x32,  // 2 (C8: 2)
-        0x33,  // 3 (C8: 3)
-        0x71,  // Q (C8: 4)
-        0x77,  // W (C8: 5)
-        0x65,  // E (C8: 6)
-        0x61,  // A (C8: 7)
-        0x73,  // S (C8: 8)
-        0x64,  // D (C8: 9)
-        0x7a,  // Z (C8: A)
-        0x63,  // C (C8: B)
-        0x34,  // 4 (C8: C)
-        0x72,  // R (C8: D)
-        0x66,  // F (C8: E)
-        0x76,  // V (C8: F)
-    };
-};
\ No newline at end of file
+    uint16_t keys = 0;
+};
+
+using Keypad = BasicKeypad<>;
@@ -1,35 +1,50 @@
 #include "memory.h"
 
-#include <fstream>
+#include <algorithm>
+#include <stdexcept>
 
-void Memory::reset() {
+template <typename Access>
+void BasicMemory<Access>::reset() {
     memory.fill(0);
     load_sprites();
 }
 
 // Copys the sprites into the memory.
-void Memory::load_sprites() {
+template <typename Access>
+void BasicMemory<Access>::load_sprites() {
     std::copy(begin(sprites), end(sprites), begin(memory));
 }
 
-// Loads a rom into memory starting at the offset.
-void Memory::load_rom(std::string filename) {
-    // Check for valid file path
-    std::ifstream file(filename);
-    if (!file.good()) {
-        throw std::runtime_error("Invalid ROM path!\n");
-    }
+// Copies the large sprites of SUPER-CHIP and XO-CHIP into the memory.
+template <typename Access>
+void BasicMemory<Access>::load_big_sprites() {
+    std::copy(begin(big_sprites), end(big_sprites), begin(memory) + big_sprites_offset);
+}
+
+// Loads a rom file into memory starting at the offset.
+template <typename Access>
+void BasicMemory<Access>::load_rom(std::string filename) {
+    load_rom(Rom::from_file(filename));
+}
 
-    // Copy file content into memory
-    auto start_addr = offset;
-    for (std::ifstream file(filename, std::ios::binary); file.good();) {
-        if (start_addr >= 0x1000) {
-            throw std::runtime_error("Out of memory!\n");
-        }
-        memory[start_addr++] = file.get();
+// Copies a rom into memory starting at the offset. Throws if it does not fit.
+template <typename Access>
+void BasicMemory<Access>::load_rom(const Rom& rom) {
+    if (rom.size() > static_cast<std::size_t>(size() - offset)) {
+        throw std::runtime_error("Out of memory!\n");
     }
+    std::copy(rom.data().begin(), rom.data().end(), memory.begin() + offset);
 }
 
-uint8_t& Memory::operator[](int index) {
-    return memory.at(index);
+template <typename Access>
+uint8_t& BasicMemory<Access>::operator[](int index) {
+    return Access::at(memory, index);
 }
+
+template <typename Access>
+uint8_t BasicMemory<Access>::operator[](int index) const {
+    return Access::at(memory, index);
+}
+
+template class BasicMemory<Checked>;
+template class BasicMemory<Wrapped>;
@@ -1,22 +1,43 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <string>
 
-class Memory {
+#include "access.h"
+#include "rom.h"
+
+// The first 4 KB of guest memory, all that the original machine and SUPER-CHIP address. XO-CHIP
+// programs also use the memory above, see ExtendedState.
+template <typename Access = DefaultAccess>
+class BasicMemory {
    public:
     static constexpr int offset = 0x200;
-    
-    Memory() {
+
+    // Address of the large SUPER-CHIP font, right after the small one
+    static constexpr int big_sprites_offset = 0x50;
+
+    BasicMemory() {
         reset();
     }
 
     void reset();
 
     void load_sprites();
+    void load_big_sprites();
     void load_rom(std::string filename);
+    void load_rom(const Rom& rom);
 
     uint8_t& operator[](int index);
+    uint8_t operator[](int index) const;
+
+    const uint8_t* data() const {
+        return memory.data();
+    }
+
+    static constexpr int size() {
+        return 0x1000;
+    }
 
    private:
     std::array<uint8_t, 0x1000> memory = {0};
@@ -38,4 +59,24 @@ class Memory {
         0xF0, 0x80, 0xF0, 0x80, 0xF0,  // E
         0xF0, 0x80, 0xF0, 0x80, 0x80   // F
     };
-};
\ No newline at end of file
+    static constexpr std::array<uint8_t, 0xA0> big_sprites = {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF,  // 0
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF,  // 1
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,  // 2
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,  // 3
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03,  // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,  // 5
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,  // 6
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18,  // 7
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,  // 8
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,  // 9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3,  // A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC,  // B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C,  // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,  // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,  // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0   // F
+    };
+};
+
+using Memory = BasicMemory<>;
@@ -0,0 +1,117 @@
+#include "movie.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "chip8.h"
+
+namespace {
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seed;
+    double fps;
+    uint32_t cpu_hz;
+    uint32_t variant;  // 0 for the original Chip8, see Variant
+    uint64_t length;
+    uint64_t events;
+};
+
+void write_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t read_varint(const std::vector<uint8_t>& in, std::size_t& position) {
+    uint64_t value = 0;
+    for (auto shift = 0; shift < 64; shift += 7) {
+        if (position >= in.size()) {
+            break;
+        }
+        auto byte = in[position++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Corrupt movie!\n");
+}
+
+}  // namespace
+
+void Movie::save(const std::string& filename) const {
+    Header header = {magic, version, seed, fps, static_cast<uint32_t>(cpu_hz), static_cast<uint32_t>(variant), length, events.size()};
+
+    std::vector<uint8_t> body;
+    uint64_t previous = 0;
+    for (auto& event : events) {
+        write_varint(body, (event.cycle - previous) << 5 | (event.key & 0xF) << 1 | (event.value != 0));
+        previous = event.cycle;
+    }
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(body.data()), body.size());
+    if (!file.good()) {
+        throw std::runtime_error("Could not write movie!\n");
+    }
+}
+
+Movie Movie::load(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.good()) {
+        throw std::runtime_error("Invalid movie path!\n");
+    }
+
+    Header header = {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file.good() || header.magic != magic) {
+        throw std::runtime_error("Not a movie file!\n");
+    }
+    if (header.version != version || header.variant > static_cast<uint32_t>(Variant::XoChip)) {
+        throw std::runtime_error("Incompatible movie version!\n");
+    }
+
+    std::vector<uint8_t> body(std::istreambuf_iterator<char>(file), {});
+
+    Movie movie;
+    movie.seed = header.seed;
+    movie.variant = static_cast<Variant>(header.variant);
+    movie.cpu_hz = header.cpu_hz;
+    movie.fps = header.fps;
+    movie.length = header.length;
+    movie.events.reserve(std::min<uint64_t>(header.events, body.size()));
+
+    std::size_t position = 0;
+    uint64_t cycle = 0;
+    for (uint64_t i = 0; i < header.events; i++) {
+        auto record = read_varint(body, position);
+        cycle += record >> 5;
+        movie.events.push_back({cycle, static_cast<uint8_t>((record >> 1) & 0xF), static_cast<uint8_t>(record & 1)});
+    }
+    return movie;
+}
+
+void MoviePlayer::run_frame(Chip8& chip8, Clock::Frame frame) {
+    chip8.run_frame({0, frame.timer_ticks});
+
+    auto end = std::min(chip8.get_cycles() + frame.cycles, movie.length);
+    while (chip8.get_cycles() < end) {
+        while (next < movie.events.size() && movie.events[next].cycle <= chip8.get_cycles()) {
+            chip8.set_key(movie.events[next].key, movie.events[next].value);
+            next++;
+        }
+        auto until = next < movie.events.size() ? std::min(end, movie.events[next].cycle) : end;
+        chip8.run(static_cast<int>(until - chip8.get_cycles()));
+    }
+}
+
+bool MoviePlayer::finished(const Chip8& chip8) const {
+    return chip8.get_cycles() >= movie.length;
+}
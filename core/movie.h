@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "clock.h"
+#include "variant.h"
+
+class Chip8;
+
+// Recorded input of a run. Together with the seed, the variant and the clock it reproduces the
+// run exactly: key transitions are stored against the cycle count at which they happened.
+//
+// On disk a movie is a small header followed by one varint per transition, holding the cycles
+// since the previous transition above the key in bits 1 to 4 and the new key state in bit 0.
+class Movie {
+   public:
+    static constexpr uint32_t magic = 0x564D3843;  // "C8MV"
+    static constexpr uint32_t version = 2;
+
+    struct Event {
+        uint64_t cycle;
+        uint8_t key;  // 0x0 to 0xF
+        uint8_t value;
+    };
+
+    uint64_t seed = 0;
+    Variant variant = Variant::Chip8;
+    int cpu_hz = 600;
+    double fps = 60.0;
+    uint64_t length = 0;  // Cycles of the whole run
+    std::vector<Event> events;
+
+    void record(uint64_t cycle, uint8_t key, uint8_t value) {
+        events.push_back({cycle, key, value});
+    }
+
+    void save(const std::string& filename) const;
+    static Movie load(const std::string& filename);
+};
+
+// Plays a movie back on a machine, applying every key transition at its cycle.
+class MoviePlayer {
+   public:
+    explicit MoviePlayer(const Movie& movie) : movie(movie) {}
+
+    // Runs one frame like Chip8::run_frame, split at the recorded transitions. Stops at the
+    // end of the movie.
+    void run_frame(Chip8& chip8, Clock::Frame frame);
+
+    bool finished(const Chip8& chip8) const;
+
+   private:
+    const Movie& movie;
+    std::size_t next = 0;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// Random numbers for the RND instruction. The generator is splitmix64: an add, three
+// xor-shifts and two multiplies per number, without branches, and every seed is valid. The
+// whole state is one word that is part of the machine state, so runs are reproducible.
+namespace prng {
+
+constexpr uint64_t default_seed = 0x853C49E6748FEA9B;
+
+inline uint64_t next(uint64_t& state) {
+    auto z = (state += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+}
+
+}  // namespace prng
@@ -0,0 +1,84 @@
+#include "rom.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+uint64_t fnv1a(const uint8_t* data, std::size_t size) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (std::size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3;
+    }
+    return hash;
+}
+
+}  // namespace
+
+Rom::Rom(const uint8_t* data, std::size_t size) : Rom(std::vector<uint8_t>(data, data + size)) {}
+
+Rom::Rom(std::vector<uint8_t> bytes) : bytes(std::move(bytes)) {
+    if (this->bytes.size() > max_size) {
+        throw std::runtime_error("Out of memory!\n");
+    }
+    content_hash = fnv1a(this->bytes.data(), this->bytes.size());
+}
+
+Rom Rom::from_file(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.good()) {
+        throw std::runtime_error("Invalid ROM path!\n");
+    }
+
+    auto size = static_cast<std::size_t>(file.tellg());
+    if (size > max_size) {
+        throw std::runtime_error("Out of memory!\n");
+    }
+
+    std::vector<uint8_t> data(size);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), size);
+    if (!file.good()) {
+        throw std::runtime_error("Invalid ROM path!\n");
+    }
+    return Rom(std::move(data));
+}
+
+std::shared_ptr<const Rom> RomCache::load(const std::string& filename) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = by_path.find(filename);
+        if (it != by_path.end()) {
+            return it->second;
+        }
+    }
+
+    // Read outside the lock, a racing load of the same path only costs a second read
+    auto rom = intern(Rom::from_file(filename));
+    std::lock_guard<std::mutex> lock(mutex);
+    return by_path.emplace(filename, rom).first->second;
+}
+
+std::shared_ptr<const Rom> RomCache::load(const uint8_t* data, std::size_t size) {
+    return intern(Rom(data, size));
+}
+
+void RomCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    by_path.clear();
+    by_hash.clear();
+}
+
+// Returns the cached image with the same content, or caches the given one.
+std::shared_ptr<const Rom> RomCache::intern(Rom rom) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = by_hash.equal_range(rom.hash());
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second->data() == rom.data()) {
+            return it->second;
+        }
+    }
+    auto shared = std::make_shared<const Rom>(std::move(rom));
+    by_hash.emplace(shared->hash(), shared);
+    return shared;
+}
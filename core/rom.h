@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Immutable program image with a hash of its content.
+class Rom {
+   public:
+    // Largest program that fits between the start offset and the end of the 64 KB of XO-CHIP.
+    // Machines with less memory reject larger programs when loading them.
+    static constexpr std::size_t max_size = 0xFE00;
+
+    // Throws if the data does not fit into memory.
+    Rom(const uint8_t* data, std::size_t size);
+
+    // Reads a whole file with a single read. Throws if it cannot be read or is too large.
+    static Rom from_file(const std::string& filename);
+
+    const std::vector<uint8_t>& data() const {
+        return bytes;
+    }
+
+    std::size_t size() const {
+        return bytes.size();
+    }
+
+    // Returns a FNV-1a hash of the content.
+    uint64_t hash() const {
+        return content_hash;
+    }
+
+   private:
+    std::vector<uint8_t> bytes;
+    uint64_t content_hash;
+
+    explicit Rom(std::vector<uint8_t> bytes);
+};
+
+// Shares one copy of every rom between all machines that load it. Files are read once per
+// path, and images with the same content are stored once. Safe to use from many threads.
+class RomCache {
+   public:
+    std::shared_ptr<const Rom> load(const std::string& filename);
+    std::shared_ptr<const Rom> load(const uint8_t* data, std::size_t size);
+
+    void clear();
+
+   private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<const Rom>> by_path;
+    std::unordered_multimap<uint64_t, std::shared_ptr<const Rom>> by_hash;
+
+    std::shared_ptr<const Rom> intern(Rom rom);
+};
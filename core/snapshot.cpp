@@ -0,0 +1,158 @@
+#include "snapshot.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "chip8.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::size_t file_size(bool extended) {
+    return sizeof(Snapshot::Header) + sizeof(MachineState) + (extended ? sizeof(ExtendedState) : 0);
+}
+
+// The header is zeroed as a whole, so that its padding is not written out uninitialized.
+Snapshot::Header expected_header(Variant variant, bool extended) {
+    Snapshot::Header header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = Snapshot::magic;
+    header.version = Snapshot::version;
+    header.state_size = sizeof(MachineState);
+    header.state_align = alignof(MachineState);
+    header.extended_size = extended ? sizeof(ExtendedState) : 0;
+    header.variant = static_cast<uint32_t>(variant);
+    return header;
+}
+
+// Returns whether an extended state follows the machine state. Only XO-CHIP machines have one.
+bool check_header(const Snapshot::Header& header) {
+    auto extended = header.extended_size != 0;
+    auto expected = expected_header(static_cast<Variant>(header.variant), extended);
+    if (header.magic != expected.magic) {
+        throw std::runtime_error("Not a snapshot file!\n");
+    }
+    if (header.version != expected.version || header.state_size != expected.state_size ||
+        header.state_align != expected.state_align || header.extended_size != expected.extended_size ||
+        header.variant > static_cast<uint32_t>(Variant::XoChip)) {
+        throw std::runtime_error("Incompatible snapshot version!\n");
+    }
+    if (extended != (header.variant == static_cast<uint32_t>(Variant::XoChip))) {
+        throw std::runtime_error("Not a snapshot file!\n");
+    }
+    return extended;
+}
+
+}  // namespace
+
+Snapshot::Snapshot(const std::string& filename) {
+#ifndef _WIN32
+    auto fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Invalid snapshot path!\n");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < file_size(false)) {
+        close(fd);
+        throw std::runtime_error("Not a snapshot file!\n");
+    }
+    mapping_size = info.st_size;
+    auto memory = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error("Could not map snapshot!\n");
+    }
+    mapping = memory;
+
+    auto bytes = static_cast<const char*>(memory);
+    auto header = reinterpret_cast<const Header*>(bytes);
+    try {
+        auto extended = check_header(*header);
+        if (mapping_size != file_size(extended)) {
+            throw std::runtime_error("Not a snapshot file!\n");
+        }
+        if (extended) {
+            extended_ptr = reinterpret_cast<const ExtendedState*>(bytes + file_size(false));
+        }
+    } catch (...) {
+        munmap(mapping, mapping_size);
+        throw;
+    }
+    state_ptr = reinterpret_cast<const MachineState*>(bytes + sizeof(Header));
+    machine = static_cast<Variant>(header->variant);
+#else
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.good()) {
+        throw std::runtime_error("Invalid snapshot path!\n");
+    }
+    Header header = {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    file.read(reinterpret_cast<char*>(&copy), sizeof(copy));
+    if (!file.good()) {
+        throw std::runtime_error("Not a snapshot file!\n");
+    }
+    if (check_header(header)) {
+        extended_copy = std::make_unique<ExtendedState>();
+        file.read(reinterpret_cast<char*>(extended_copy.get()), sizeof(ExtendedState));
+        if (!file.good()) {
+            throw std::runtime_error("Not a snapshot file!\n");
+        }
+        extended_ptr = extended_copy.get();
+    }
+    state_ptr = &copy;
+    machine = static_cast<Variant>(header.variant);
+#endif
+}
+
+Snapshot::~Snapshot() {
+#ifndef _WIN32
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_size);
+    }
+#endif
+}
+
+// A machine of another variant would run the state with the wrong instructions and memory.
+void Snapshot::restore(Chip8& chip8) const {
+    if (chip8.get_variant() != machine) {
+        throw std::runtime_error("Snapshot of a different variant!\n");
+    }
+    chip8.load(*state_ptr);
+    if (extended_ptr != nullptr) {
+        chip8.load(*extended_ptr);
+    }
+}
+
+// Writes a state to a snapshot file, replacing the file if it exists.
+void Snapshot::write(const std::string& filename, const MachineState& state, Variant variant,
+                     const ExtendedState* extended) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    auto header = expected_header(variant, extended != nullptr);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(&state), sizeof(state));
+    if (extended != nullptr) {
+        file.write(reinterpret_cast<const char*>(extended), sizeof(*extended));
+    }
+    if (!file.good()) {
+        throw std::runtime_error("Could not write snapshot!\n");
+    }
+}
+
+void Snapshot::save(const std::string& filename, const Chip8& chip8) {
+    MachineState state;
+    chip8.save(state);
+    if (!chip8.has_extended_state()) {
+        write(filename, state, chip8.get_variant());
+        return;
+    }
+    auto extended = std::make_unique<ExtendedState>();
+    chip8.save(*extended);
+    write(filename, state, chip8.get_variant(), extended.get());
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "state.h"
+#include "variant.h"
+
+class Chip8;
+
+// Machine state on disk. A snapshot file is a 64 byte header followed by the raw
+// MachineState and, for XO-CHIP machines, the raw ExtendedState, so that a mapped file can be
+// used in place. The header records the layout the state was written with and the variant of
+// the machine. Files from a different version or build are rejected.
+class Snapshot {
+   public:
+    static constexpr uint32_t magic = 0x53533843;  // "C8SS"
+    static constexpr uint32_t version = 6;
+
+    struct alignas(64) Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t state_size;
+        uint32_t state_align;
+        uint32_t extended_size;  // Size of the ExtendedState, or 0 if there is none
+        uint32_t variant;        // 0 for the original Chip8, see Variant
+    };
+
+    // Maps a snapshot file. Throws if it cannot be read or is not a valid snapshot.
+    explicit Snapshot(const std::string& filename);
+    ~Snapshot();
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    const MachineState& state() const {
+        return *state_ptr;
+    }
+
+    // Returns the extended state of an XO-CHIP machine, or nullptr if the snapshot has none.
+    const ExtendedState* extended() const {
+        return extended_ptr;
+    }
+
+    Variant variant() const {
+        return machine;
+    }
+
+    // Loads the state into a machine. Throws if the machine emulates a different variant.
+    void restore(Chip8& chip8) const;
+
+    static void write(const std::string& filename, const MachineState& state, Variant variant,
+                      const ExtendedState* extended = nullptr);
+
+    // Writes the state of a machine, with its extended state if it has one.
+    static void save(const std::string& filename, const Chip8& chip8);
+
+   private:
+    void* mapping = nullptr;
+    std::size_t mapping_size = 0;
+    const MachineState* state_ptr = nullptr;
+    const ExtendedState* extended_ptr = nullptr;
+    Variant machine = Variant::Chip8;
+#ifdef _WIN32
+    // Hold the state on hosts without mmap
+    MachineState copy;
+    std::unique_ptr<ExtendedState> extended_copy;
+#endif
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+#include "display.h"
+#include "keypad.h"
+#include "memory.h"
+
+// Everything that makes up the state of a machine, in one block without pointers. Copying it
+// is a complete snapshot of a Chip8, see Chip8::save and Chip8::load.
+struct alignas(64) MachineState {
+    std::array<uint8_t, 0x10> regs = {0};
+    std::array<uint16_t, 0x10> stack = {0};
+
+    uint16_t I = {0};   // Index register
+    uint16_t pc = {0};  // Program counter
+    uint16_t sp = {0};  // Stack pointer
+    uint8_t delay_timer = 0;
+    uint8_t sound_timer = 0;
+
+    uint64_t rng = 0;          // State of the random number generator, see prng::next
+    uint64_t cycle_count = 0;  // Instructions run since the reset
+
+    std::array<uint8_t, 0x10> flags = {0};          // SUPER-CHIP flag registers
+    std::array<uint8_t, 0x10> audio_pattern = {0};  // XO-CHIP 1 bit samples, the first in the MSB
+    uint8_t pitch = 64;                             // XO-CHIP sample rate, 4000 * 2^((pitch - 64) / 48) Hz
+
+    Memory memory;
+    Display display;
+    Keypad keypad;
+};
+
+static_assert(std::is_trivially_copyable<MachineState>::value, "MachineState must be copyable with memcpy");
+
+// The memory of XO-CHIP above the first 4 KB. It is kept out of MachineState, so that the other
+// machines save and restore only what they can address. XO-CHIP machines save it alongside.
+struct alignas(64) ExtendedState {
+    std::array<uint8_t, 0x10000 - Memory::size()> memory = {0};
+};
+
+static_assert(std::is_trivially_copyable<ExtendedState>::value, "ExtendedState must be copyable with memcpy");
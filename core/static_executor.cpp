@@ -0,0 +1,101 @@
+#include "static_executor.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool StaticExecutor::add(const StaticProgram& program) {
+    programs().push_back(&program);
+    return true;
+}
+
+std::vector<const StaticProgram*>& StaticExecutor::programs() {
+    static std::vector<const StaticProgram*> all;
+    return all;
+}
+
+// Runs compiled blocks while the budget allows it and interprets the remaining instructions.
+void StaticExecutor::run(Chip8& chip8, int cycles) {
+    if (!selected) {
+        select(chip8);
+    }
+    while (cycles > 0) {
+        auto block = lookup(chip8);
+        if (block == nullptr || block->length > cycles) {
+            chip8.tick();
+            cycles--;
+            continue;
+        }
+        cycles -= block->run(chip8);
+    }
+}
+
+// Marks every block that may contain the byte at the given address for another comparison
+// with the image before it runs again.
+void StaticExecutor::invalidate(int address) {
+    address &= 0xFFF;
+    if (!covered[address]) {
+        return;
+    }
+    for (auto start = std::max(0, address - 2 * max_length); start <= address; start++) {
+        verified[start] = false;
+    }
+}
+
+void StaticExecutor::flush() {
+    selected = false;
+    program = nullptr;
+}
+
+// Picks the program whose image was loaded, if it was compiled for the current variant.
+void StaticExecutor::select(const Chip8& chip8) {
+    selected = true;
+    program = nullptr;
+    blocks.fill(nullptr);
+    verified.reset();
+    covered.reset();
+
+    // XO-CHIP images larger than 4 KB continue in the extended memory
+    auto loaded = chip8.memory.data() + Memory::offset;
+    auto capacity = static_cast<std::size_t>(chip8.address_mask() + 1 - Memory::offset);
+    for (auto candidate : programs()) {
+        if (candidate->variant != chip8.variant || candidate->size > capacity) {
+            continue;
+        }
+        auto low = std::min(candidate->size, static_cast<std::size_t>(Memory::size() - Memory::offset));
+        if (std::memcmp(loaded, candidate->image, low) == 0 &&
+            (low == candidate->size ||
+             std::memcmp(chip8.extended->memory.data(), candidate->image + low, candidate->size - low) == 0)) {
+            program = candidate;
+            break;
+        }
+    }
+    if (program == nullptr) {
+        return;
+    }
+
+    for (std::size_t i = 0; i < program->block_count; i++) {
+        auto& block = program->blocks[i];
+        blocks[block.address] = &block;
+        for (auto address = block.address; address < block.address + 2 * block.length; address++) {
+            covered[address] = true;
+        }
+    }
+}
+
+// Returns the block at the program counter if memory still holds the code it was compiled
+// from, or nullptr.
+const StaticBlock* StaticExecutor::lookup(Chip8& chip8) {
+    if (chip8.pc >= blocks.size()) {
+        return nullptr;
+    }
+    auto block = blocks[chip8.pc];
+    if (block == nullptr || verified[chip8.pc]) {
+        return block;
+    }
+    auto code = program->image + (block->address - Memory::offset);
+    if (std::memcmp(chip8.memory.data() + block->address, code, 2 * block->length) != 0) {
+        return nullptr;
+    }
+    verified[chip8.pc] = true;
+    return block;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "chip8.h"
+#include "executor.h"
+#include "instruction.h"
+#include "state.h"
+#include "variant.h"
+
+// A basic block that chip8_recompile compiled to C++ ahead of time. Runs its instructions
+// from the address on and returns how many it ran, which is fewer than its length if a skip
+// was taken.
+struct StaticBlock {
+    uint16_t address;
+    uint16_t length;  // Number of instructions
+    int (*run)(Chip8& chip8);
+};
+
+// A rom compiled ahead of time: the image it was compiled from, for the variant it was
+// compiled for, and its blocks sorted by address.
+struct StaticProgram {
+    const char* name;
+    Variant variant;
+    const uint8_t* image;  // Loaded at Memory::offset
+    std::size_t size;
+    const StaticBlock* blocks;
+    std::size_t block_count;
+};
+
+// Runs roms that were compiled into the binary with chip8_recompile. The program is picked by
+// the content of memory after a rom was loaded. A block only runs while the memory it covers
+// still holds the instructions it was compiled from, so code the rom writes to and addresses
+// that the trace did not reach, like most targets of computed jumps, are interpreted.
+class StaticExecutor : public Executor {
+   public:
+    static constexpr int max_length = 32;
+
+    // Makes a compiled program available to every StaticExecutor. Generated files call it
+    // from a static initializer.
+    static bool add(const StaticProgram& program);
+
+    void run(Chip8& chip8, int cycles) override;
+    void invalidate(int address) override;
+    void flush() override;
+
+   private:
+    const StaticProgram* program = nullptr;
+    bool selected = false;  // Whether program was picked since the last flush
+
+    std::array<const StaticBlock*, 0x1000> blocks = {};
+    std::bitset<0x1000> verified;  // Blocks whose memory matched the image since the last write
+    std::bitset<0x1000> covered;   // Bytes that belong to any block
+
+    static std::vector<const StaticProgram*>& programs();
+
+    void select(const Chip8& chip8);
+    const StaticBlock* lookup(Chip8& chip8);
+};
+
+// The interface of generated code to the private state of a Chip8.
+struct StaticCode {
+    static MachineState& state(Chip8& chip8) {
+        return chip8;
+    }
+
+    // Runs an instruction through its interpreter handler.
+    static void execute(Chip8& chip8, const Instruction& ins) {
+        ins.handler(chip8, ins);
+    }
+
+    static Instruction decode(int opcode, Variant variant) {
+        return Chip8::decode(opcode, variant);
+    }
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// The machine a program was written for. Each variant runs the programs of the one before it.
+enum class Variant : uint8_t {
+    Chip8,      // The original: 64x32 pixels, 4 KB of memory
+    SuperChip,  // SUPER-CHIP 1.1: 128x64 hi-res mode, scrolling, a large font, flag registers
+    XoChip,     // XO-CHIP: 64 KB of memory, two bitplanes, long loads of I, an audio pattern
+};
+
+// Parses "chip8", "schip" or "xochip". Returns false for any other name.
+inline bool parse_variant(const std::string& name, Variant& variant) {
+    if (name == "chip8") {
+        variant = Variant::Chip8;
+    } else if (name == "schip") {
+        variant = Variant::SuperChip;
+    } else if (name == "xochip") {
+        variant = Variant::XoChip;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Guesses the variant of a rom from the usual file extensions, .sc8 and .xo8.
+inline Variant guess_variant(const std::string& filename) {
+    auto ends_with = [&filename](const std::string& suffix) {
+        return filename.size() >= suffix.size() &&
+               filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (ends_with(".xo8")) {
+        return Variant::XoChip;
+    }
+    if (ends_with(".sc8")) {
+        return Variant::SuperChip;
+    }
+    return Variant::Chip8;
+}
@@ -0,0 +1,72 @@
+#include "beeper.h"
+
+#include <algorithm>
+#include <iostream>
+
+Beeper::~Beeper() {
+    close();
+}
+
+bool Beeper::open() {
+    SDL_AudioSpec want = {};
+    want.freq = sample_rate;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = buffer_samples;
+    want.callback = &Beeper::callback;
+    want.userdata = this;
+
+    SDL_AudioSpec have;
+    device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+    if (device == 0) {
+        std::cerr << "SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_PauseAudioDevice(device, 0);
+    return true;
+}
+
+void Beeper::close() {
+    if (device != 0) {
+        SDL_CloseAudioDevice(device);
+        device = 0;
+    }
+}
+
+void Beeper::play(bool on, double seconds) {
+    if (device != 0) {
+        ring.push({on, static_cast<float>(seconds)});
+    }
+}
+
+void Beeper::callback(void* userdata, uint8_t* stream, int length) {
+    static_cast<Beeper*>(userdata)->fill(reinterpret_cast<int16_t*>(stream), length / static_cast<int>(sizeof(int16_t)));
+}
+
+// Runs on the audio thread.
+void Beeper::fill(int16_t* samples, int count) {
+    Tone tone;
+    while (ring.size() > max_backlog && ring.pop(tone)) {
+        on = tone.on;
+        remaining = 0;
+    }
+
+    auto step = amplitude / (ramp_seconds * sample_rate);
+    for (auto i = 0; i < count; i++) {
+        if (remaining <= 0) {
+            if (ring.pop(tone)) {
+                on = tone.on;
+                remaining += tone.seconds * sample_rate;
+            } else {
+                remaining = 0;
+            }
+        }
+        remaining--;
+
+        auto target = on ? amplitude : 0.0;
+        level += std::clamp(target - level, -step, step);
+        phase += frequency / sample_rate;
+        phase -= static_cast<int>(phase);
+        samples[i] = static_cast<int16_t>(phase < 0.5 ? level : -level);
+    }
+}
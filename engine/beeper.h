@@ -0,0 +1,53 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <cstdint>
+
+#include "spsc_ring.h"
+
+// Square wave beeper on an SDL audio device, switched by the sound timer.
+//
+// The emulation loop pushes the tone state of every frame into a lock-free ring, and the audio
+// callback plays each state for the length of its frame. When frames arrive late the last
+// state is held, and when they pile up the oldest are skipped, so frame pacing jitter neither
+// starves the device nor builds up latency. The callback never locks or allocates.
+class Beeper {
+   public:
+    ~Beeper();
+
+    // Opens the default audio device. Returns false if there is none, in which case tones
+    // are ignored.
+    bool open();
+    void close();
+
+    // Queues the tone state for a frame of the given length.
+    void play(bool on, double seconds);
+
+   private:
+    struct Tone {
+        bool on;
+        float seconds;
+    };
+
+    static constexpr int sample_rate = 44100;
+    static constexpr uint16_t buffer_samples = 256;  // About 6 ms
+    static constexpr double frequency = 440.0;
+    static constexpr double amplitude = 6000.0;
+    static constexpr double ramp_seconds = 0.002;  // Fade in and out to avoid clicks
+
+    // Frames queued beyond this are skipped to bound the latency
+    static constexpr std::size_t max_backlog = 4;
+
+    SDL_AudioDeviceID device = 0;
+    SpscRing<Tone, 64> ring;
+
+    // State of the audio thread
+    bool on = false;
+    double remaining = 0;  // Samples left of the current frame
+    double level = 0;
+    double phase = 0;
+
+    static void callback(void* userdata, uint8_t* stream, int length);
+    void fill(int16_t* samples, int count);
+};
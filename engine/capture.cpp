@@ -0,0 +1,240 @@
+#include "capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+#include "frontend.h"
+
+namespace {
+
+// Header of the run-length format, followed by one record per distinct frame
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    double fps;
+    uint32_t width;
+    uint32_t height;
+};
+
+constexpr uint32_t runs_magic = 0x4C523843;  // "C8RL"
+constexpr uint32_t runs_version = 1;
+
+void write_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+int leading_zeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(value);
+#else
+    auto count = 0;
+    for (auto bit = uint64_t{1} << 63; (value & bit) == 0; bit >>= 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+bool ends_with(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+Capture::Capture(const std::string& filename, double fps)
+    : format(ends_with(filename, ".y4m") ? Format::Y4m : Format::Runs),
+      fps(fps),
+      file(filename, std::ios::binary | std::ios::trunc),
+      pool(pool_size) {
+    if (!file.good()) {
+        throw std::runtime_error("Could not open capture file!\n");
+    }
+    for (auto& slot : pool) {
+        spare.push(&slot);
+    }
+    write_header();
+    writer = std::thread(&Capture::write_loop, this);
+}
+
+Capture::~Capture() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // Only close() reports a failed write
+    }
+}
+
+// Compares the frame with the previous one and hands it to the writer if it changed. Waits
+// for the writer only if every slot of the pool is queued.
+void Capture::push(const Display& display) {
+    if (has_last && display == last) {
+        frame_count++;
+        return;
+    }
+
+    Slot* slot;
+    if (!spare.pop(slot)) {
+        stall_count++;
+        while (!spare.pop(slot)) {
+            std::this_thread::yield();
+        }
+    }
+    slot->display = display;
+    slot->frame = frame_count++;
+    filled.push(slot);
+
+    last = display;
+    has_last = true;
+}
+
+void Capture::close() {
+    if (!writer.joinable()) {
+        return;
+    }
+    total.store(frame_count, std::memory_order_relaxed);
+    finished.store(true, std::memory_order_release);
+    writer.join();
+
+    file.close();
+    if (failed || file.fail()) {
+        throw std::runtime_error("Could not write capture!\n");
+    }
+}
+
+// Takes queued frames until the emulation finished and the queue is drained. While frames
+// keep coming the writer only yields between them, so a fast emulation rarely finds the pool
+// empty. After a quiet spell it sleeps for a millisecond at a time.
+void Capture::write_loop() {
+    using clock = std::chrono::steady_clock;
+    auto last_frame = clock::now();
+    while (true) {
+        Slot* slot;
+        if (filled.pop(slot)) {
+            take(slot);
+            last_frame = clock::now();
+            continue;
+        }
+        if (finished.load(std::memory_order_acquire)) {
+            // Frames pushed before the flag was set are visible now
+            if (filled.pop(slot)) {
+                take(slot);
+                continue;
+            }
+            break;
+        }
+        if (clock::now() - last_frame < std::chrono::microseconds(200)) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    if (held != nullptr) {
+        write(held->display, total.load(std::memory_order_relaxed) - held->frame);
+        spare.push(held);
+        held = nullptr;
+    }
+    file.flush();
+}
+
+// Writes the held frame, which lasted until the given one, and holds that one instead.
+void Capture::take(Slot* slot) {
+    if (held != nullptr) {
+        write(held->display, slot->frame - held->frame);
+        spare.push(held);
+    }
+    held = slot;
+}
+
+void Capture::write_header() {
+    if (format == Format::Y4m) {
+        // Integral rates are kept exact, others are given in thousandths
+        char line[128];
+        auto rounded = std::lround(fps);
+        if (std::fabs(fps - rounded) < 1e-9) {
+            std::snprintf(line, sizeof(line), "YUV4MPEG2 W%d H%d F%ld:1 Ip A1:1 Cmono\n", Display::m_width,
+                          Display::m_height, rounded);
+        } else {
+            std::snprintf(line, sizeof(line), "YUV4MPEG2 W%d H%d F%ld:1000 Ip A1:1 Cmono\n", Display::m_width,
+                          Display::m_height, std::lround(fps * 1000));
+        }
+        file << line;
+        return;
+    }
+    Header header = {runs_magic, runs_version, fps, Display::m_width, Display::m_height};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+// Writes a frame that was on screen for the given number of emulated frames. Y4M repeats the
+// picture, the run-length format stores the count.
+void Capture::write(const Display& display, uint64_t count) {
+    if (count == 0 || failed) {
+        return;
+    }
+    buffer.clear();
+    if (format == Format::Y4m) {
+        encode_gray(display);
+        for (uint64_t i = 0; i < count; i++) {
+            file << "FRAME\n";
+            file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+        }
+    } else {
+        write_varint(buffer, count);
+        encode_runs(display);
+        file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    }
+    failed = !file.good();
+}
+
+// Converts the frame to the video range gray levels of the frontend palette, with lo-res
+// pixels doubled like on screen.
+void Capture::encode_gray(const Display& display) {
+    argb.resize(Display::m_width * Display::m_height);
+    display.expand(argb.data(), Display::m_width, Frontend::palette);
+    buffer.resize(argb.size());
+    for (std::size_t i = 0; i < argb.size(); i++) {
+        buffer[i] = static_cast<uint8_t>(16 + 219 * (argb[i] & 0xFF) / 255);
+    }
+}
+
+// Encodes a frame as a flags byte, bit 0 for hi-res, and then each plane as varint lengths
+// of alternating runs of unset and set pixels. The runs start unset and cover the 64x32 or
+// 128x64 screen in row-major order, so they sum up to its size. A record starts with the
+// number of emulated frames it lasted.
+void Capture::encode_runs(const Display& display) {
+    buffer.push_back(display.is_hires() ? 1 : 0);
+    auto words = display.active_width() / 64;
+    for (auto plane = 0; plane < Display::planes; plane++) {
+        uint64_t run = 0;
+        auto set = false;
+        for (auto y = 0; y < display.active_height(); y++) {
+            auto& row = display.line(plane, y);
+            for (auto index = 0; index < words; index++) {
+                auto word = index == 0 ? row.hi : row.lo;
+                auto bits = 64;
+                while (true) {
+                    // Pixels of the current run show up as leading zeros
+                    auto same = set ? ~word : word;
+                    auto length = same == 0 ? bits : std::min(bits, leading_zeros(same));
+                    run += length;
+                    bits -= length;
+                    if (bits == 0) {
+                        break;
+                    }
+                    word <<= length;
+                    write_varint(buffer, run);
+                    run = 0;
+                    set = !set;
+                }
+            }
+        }
+        write_varint(buffer, run);
+    }
+}
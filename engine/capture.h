@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../core/display.h"
+#include "spsc_ring.h"
+
+// Records every emulated frame to a lossless video file on a background thread.
+//
+// The emulation thread only compares the framebuffer with the previous frame. Frames that
+// changed are copied into a slot of a pool that is allocated once and handed to the writer
+// thread by pointer through a lock-free queue; the writer encodes them and gives the slot
+// back through a second queue. Unchanged frames only extend the duration of the previous one.
+// If the writer falls behind by a whole pool, the emulation waits for a slot, so no frame is
+// lost.
+//
+// Two formats are written, picked by the file extension:
+// - .y4m: uncompressed 8 bit grayscale YUV4MPEG2 at 128x64, playable by most video tools.
+// - Anything else: run-length encoded bitplanes, see Capture::encode_runs.
+class Capture {
+   public:
+    enum class Format { Y4m, Runs };
+
+    static constexpr std::size_t pool_size = 64;
+
+    // Opens the file and starts the writer thread. Throws if the file cannot be written.
+    Capture(const std::string& filename, double fps);
+    ~Capture();
+
+    Capture(const Capture&) = delete;
+    Capture& operator=(const Capture&) = delete;
+
+    // Emulation side. Takes the framebuffer at the end of an emulated frame.
+    void push(const Display& display);
+
+    // Writes the remaining frames, closes the file and stops the writer thread. Throws if
+    // writing failed.
+    void close();
+
+    uint64_t frames() const {
+        return frame_count;
+    }
+
+    // Number of times the emulation waited for the writer.
+    uint64_t stalls() const {
+        return stall_count;
+    }
+
+   private:
+    // A changed frame and the number of the emulated frame it first appeared in
+    struct Slot {
+        Display display;
+        uint64_t frame;
+    };
+
+    Format format;
+    double fps;
+    std::ofstream file;
+
+    std::vector<Slot> pool;
+    SpscRing<Slot*, pool_size> filled;  // From the emulation to the writer
+    SpscRing<Slot*, pool_size> spare;   // Back from the writer
+
+    // Emulation side
+    Display last;
+    bool has_last = false;
+    uint64_t frame_count = 0;
+    uint64_t stall_count = 0;
+
+    // Set with the final frame count once the emulation stopped pushing
+    std::atomic<bool> finished{false};
+    std::atomic<uint64_t> total{0};
+
+    // Writer side: the newest frame, which is written and given back once the next one shows
+    // how long it lasted
+    Slot* held = nullptr;
+    std::vector<uint8_t> buffer;  // Encoded output of one frame
+    std::vector<uint32_t> argb;   // Expanded frame for the gray levels
+    bool failed = false;
+
+    std::thread writer;
+
+    void write_loop();
+    void take(Slot* slot);
+    void write_header();
+    void write(const Display& display, uint64_t count);
+    void encode_gray(const Display& display);
+    void encode_runs(const Display& display);
+};
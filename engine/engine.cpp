@@ -1,58 +1,511 @@
 #include "engine.h"
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <thread>
+#include <utility>
 
-// Initializes a SDL window.
-bool Engine::init(int cycles, float fps) {
-    cycles_per_second = cycles;
-    frames_per_second = fps;
-    auto res_window = window.init(Display::width(), Display::height(), "Chip8");
-    return res_window;
+#include "../core/snapshot.h"
+#include "profiler.h"
+
+// Initializes the frontend. The CPU runs at the given clock rate in Hz, independent of the
+// frame rate.
+bool Engine::init(int cpu_hz, float fps) {
+    clock = Clock(cpu_hz, fps);
+    scheduler = Scheduler(fps);
+    frame_skip = FrameSkip(turbo_skip, 0.1, fps);
+    auto res_frontend = frontend->init(Display::width(), Display::height(), "Chip8");
+    if (frontend->realtime()) {
+        rewind = std::make_unique<Rewind>();
+    }
+    return res_frontend;
 }
 
 // Loads a rom
 void Engine::load_rom(std::string filename) {
     chip8.reset();
     chip8.load_rom(filename);
+    if (rewind) {
+        rewind->clear();
+        extended_snapshot = chip8.has_extended_state() ? std::make_unique<ExtendedState>() : nullptr;
+    }
+}
+
+// Selects how the chip8 executes instructions.
+void Engine::set_execution_mode(ExecutionMode mode) {
+    chip8.set_execution_mode(mode);
+}
+
+// Seeds the random number generator of the chip8.
+void Engine::seed(uint64_t value) {
+    chip8.seed(value);
+}
+
+void Engine::set_variant(Variant variant) {
+    chip8.set_variant(variant);
+}
+
+// Rewinding is disabled while recording, since it would break the cycle order of the input.
+void Engine::record(std::string filename) {
+    movie = std::make_unique<Movie>();
+    movie->seed = chip8.get_seed();
+    movie->variant = chip8.get_variant();
+    movie->cpu_hz = clock.get_cpu_hz();
+    movie->fps = clock.get_fps();
+    movie_path = filename;
+    chip8.record(movie.get());
+    rewind.reset();
+}
+
+// The seed, variant and clock of the movie replace the current ones.
+void Engine::replay(std::string filename) {
+    movie = std::make_unique<Movie>(Movie::load(filename));
+    player = std::make_unique<MoviePlayer>(*movie);
+    chip8.seed(movie->seed);
+    chip8.set_variant(movie->variant);
+    clock = Clock(movie->cpu_hz, movie->fps);
+    frame_skip = FrameSkip(turbo_skip, 0.1, clock.get_fps());
+    rewind.reset();
+}
+
+// The history of rewinding starts again from the loaded state.
+void Engine::load_state(std::string filename) {
+    Snapshot(filename).restore(chip8);
+    if (rewind) {
+        rewind->clear();
+    }
+}
+
+void Engine::save_state(std::string filename) {
+    state_path = filename;
+}
+
+void Engine::capture(std::string filename) {
+    video = std::make_unique<Capture>(filename, clock.get_fps());
+}
+
+void Engine::show_stats(bool enabled) {
+    stats = enabled;
+}
+
+// Turbo presents at most at the frame rate of the clock.
+void Engine::set_turbo(bool enabled, int skip) {
+    frontend->turbo = enabled;
+    turbo_skip = skip;
+    frame_skip = FrameSkip(skip, 0.1, clock.get_fps());
+}
+
+void Engine::set_threaded(bool enabled) {
+    threaded = enabled;
 }
 
-// Starts the emulator. Frames per second are currently fixed to 60.
+// Starts the emulator and returns when the frontend stops running.
 void Engine::start() {
-    auto get_time = [] { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count(); };
+    auto started = std::chrono::steady_clock::now();
+    last_poll = started;
+
+    if (threaded && frontend->realtime()) {
+        run_threads();
+    } else {
+        run_frames();
+    }
+
+    if (frontend->realtime()) {
+        scheduler.report(std::cout);
+        latency.report(std::cout);
+    }
+    if (frame_skip.skipped() > 0) {
+        std::cout << "Skipped " << frame_skip.skipped() << " frames in turbo" << std::endl;
+    }
+#ifdef CHIP8_PROFILE
+    Profiler::get().report(std::cout);
+#endif
+
+    if (video) {
+        video->close();
+        std::cout << "Captured " << video->frames() << " frames";
+        if (video->stalls() > 0) {
+            std::cout << ", waited " << video->stalls() << " times for the writer";
+        }
+        std::cout << std::endl;
+    }
 
-    auto start = get_time();
+    if (player) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        std::cout << "Replayed " << chip8.get_cycles() << " of " << movie->length << " cycles in " << elapsed.count()
+                  << " s, framebuffer hash " << std::hex << chip8.get_display().hash() << std::dec << std::endl;
+    } else if (movie) {
+        chip8.record(nullptr);
+        movie->length = chip8.get_cycles();
+        movie->save(movie_path);
+    }
+    if (!state_path.empty()) {
+        Snapshot::save(state_path, chip8);
+    }
+}
+
+// Runs input, emulation and presents on the calling thread. Realtime frontends are paced by
+// sleeping until the next frame is due, or by the vsync of present(), unless they are in
+// turbo. Other frontends run frames back to back.
+void Engine::run_frames() {
+    scheduler.start();
+
+#ifdef CHIP8_PROFILE
+    auto next_stats = Profiler::clock::now() + std::chrono::seconds(1);
+#endif
 
-    while (window.running) {
-        auto delta = get_time() - start;
-        if (delta > (1000.0 / frames_per_second)) {
-            start = get_time();
+    auto fast = false;
+    while (frontend->running) {
+        CHIP8_PROFILE_SCOPE(frame);
+        if (fast != (frontend->turbo && frontend->realtime())) {
+            // Pacing starts over from now when turbo ends
+            fast = !fast;
+            scheduler.start();
+            frame_skip.reset();
+        }
+
+        if (fast) {
+            fast_forward();
+        } else if (!frontend->realtime()) {
             update();
             draw();
+        } else if (frontend->vsync()) {
+            for (auto frames = scheduler.due(); frames > 0; frames--) {
+                update();
+            }
+            draw();
+        } else {
+            {
+                CHIP8_PROFILE_SCOPE(wait);
+                scheduler.wait();
+            }
+            update();
+            draw();
+        }
+
+#ifdef CHIP8_PROFILE
+        if (stats && Profiler::clock::now() >= next_stats) {
+            frontend->show_stats(Profiler::get().readout());
+            next_stats += std::chrono::seconds(1);
         }
+#endif
     }
 }
 
-// Updates the internal chip8 state, polls for keyboard input and then runs 10 cpu cycles.
-void Engine::update() {
-    chip8.update_delay_timer();
+// Moves the emulation to a second thread. The calling thread keeps input and presenting,
+// which SDL wants on the thread that created the window. Finished frames go to it through a
+// triple buffer and input comes back through a queue, so neither side waits for the other.
+void Engine::run_threads() {
+    frames = std::make_unique<TripleBuffer<Frame>>();
+    input_queue = std::make_unique<SpscRing<KeyEvent, 256>>();
+    tone_queue = std::make_unique<SpscRing<Tone, 256>>();
+    finished.store(false, std::memory_order_relaxed);
+    controls.store(control_flags(), std::memory_order_release);
+
+    std::thread emulation(&Engine::emulation_loop, this);
+    render_loop();
+    controls.store(0, std::memory_order_release);
+    emulation.join();
+
+    tone_queue.reset();
+    input_queue.reset();
+    frames.reset();
+}
 
-    window.poll_events(&chip8);
+// Paces and runs frames and publishes every finished framebuffer. In turbo, frames run back
+// to back and the frame skip picks the ones that are published.
+void Engine::emulation_loop() {
+    scheduler.start();
 
-    for (auto i = 0; i < cycles_per_second; i++) {
-        chip8.tick();
+    auto fast = false;
+    while (controls.load(std::memory_order_acquire) & control_running) {
+        CHIP8_PROFILE_SCOPE(frame);
+        if (!fast) {
+            CHIP8_PROFILE_SCOPE(wait);
+            scheduler.wait();
+        }
+        update();
+        if (fast != turbo) {
+            fast = turbo;
+            scheduler.start();
+            frame_skip.reset();
+        }
+
+        if (fast) {
+            if (!frame_skip.due()) {
+                continue;
+            }
+            frame_skip.presented({});
+            play_tone(false);
+            if (rewind && !rewinding) {
+                remember();
+            }
+        }
+
+        auto& frame = frames->back();
+        frame.display = chip8.get_display();
+        frame.inputs = inputs;
+        frames->publish();
     }
 }
 
-// Draws every pixel of the window that needs to be drawn.
-void Engine::draw() {
-    window.clear_screen();
-    for (auto y = 0; y < Display::m_height; y++) {
-        for (auto x = 0; x < Display::m_width; x++) {
-            if (chip8.get_pixel(x + (y * Display::m_width))) {
-                window.draw_pixel(x, y, Display::scale);
+// Polls input and hands it to the emulation thread, and presents every new frame and plays
+// the tones of the emulated frames. Without vsync it sleeps for a millisecond while there is
+// no new frame.
+void Engine::render_loop() {
+    std::vector<KeyEvent> pending;
+    uint64_t sent = 0;
+
+#ifdef CHIP8_PROFILE
+    auto next_stats = Profiler::clock::now() + std::chrono::seconds(1);
+#endif
+
+    while (frontend->running) {
+        {
+            CHIP8_PROFILE_SCOPE(poll);
+            frontend->poll_events(pending);
+        }
+
+        // Events that do not fit into the queue wait for the next round
+        std::size_t pushed = 0;
+        while (pushed < pending.size() && input_queue->push(pending[pushed])) {
+            latency.input(pending[pushed].time, sent++);
+            pushed++;
+        }
+        pending.erase(pending.begin(), pending.begin() + pushed);
+        if (finished.load(std::memory_order_acquire)) {
+            frontend->running = false;
+        }
+        controls.store(control_flags(), std::memory_order_release);
+
+        Tone tone;
+        while (tone_queue->pop(tone)) {
+            frontend->play_tone(tone.on, tone.seconds);
+        }
+
+        if (frames->update() || frontend->vsync()) {
+            {
+                CHIP8_PROFILE_SCOPE(draw);
+                frontend->present(frames->front().display);
+            }
+            latency.presented(frames->front().inputs);
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+#ifdef CHIP8_PROFILE
+        if (stats && Profiler::clock::now() >= next_stats) {
+            frontend->show_stats(Profiler::get().readout());
+            next_stats += std::chrono::seconds(1);
+        }
+#endif
+    }
+}
+
+uint8_t Engine::control_flags() const {
+    return (frontend->running ? control_running : 0) | (frontend->rewinding ? control_rewinding : 0) |
+           (frontend->turbo ? control_turbo : 0);
+}
+
+// Takes in the key changes since the previous poll, from the frontend or in threaded mode
+// from the render thread.
+void Engine::poll() {
+    events.clear();
+    {
+        CHIP8_PROFILE_SCOPE(poll);
+        if (input_queue) {
+            KeyEvent event;
+            while (input_queue->pop(event)) {
+                events.push_back(event);
+            }
+            auto flags = controls.load(std::memory_order_acquire);
+            rewinding = flags & control_rewinding;
+            turbo = flags & control_turbo;
+        } else {
+            frontend->poll_events(events);
+            rewinding = frontend->rewinding;
+            turbo = frontend->turbo && frontend->realtime();
+            for (std::size_t i = 0; i < events.size(); i++) {
+                latency.input(events[i].time, inputs + i);
+            }
+        }
+    }
+    previous_poll = std::exchange(last_poll, std::chrono::steady_clock::now());
+    inputs += events.size();
+}
+
+// Polls for keyboard input and then runs one frame, see step().
+void Engine::update() {
+    poll();
+    step();
+    if (video) {
+        video->push(chip8.get_display());
+    }
+}
+
+// Runs one frame of timer ticks and cpu cycles with the polled input. While the frontend is
+// rewinding, the previous frame is restored from the history instead. A replay takes its
+// input from the movie.
+void Engine::step() {
+    if (player) {
+        player->run_frame(chip8, clock.next_frame());
+        if (player->finished(chip8)) {
+            stop();
+        }
+        return;
+    }
+
+    if (rewind && rewinding) {
+        for (auto& event : events) {
+            chip8.set_key(event.key, event.pressed);
+        }
+        // The keys stay as the player holds them now, not as they were in the restored frame
+        auto keys = chip8.get_keys();
+        if (rewind->step_back(snapshot, extended_snapshot.get())) {
+            chip8.load(snapshot);
+            if (extended_snapshot) {
+                chip8.load(*extended_snapshot);
+            }
+            for (auto key = 0; key < 0x10; key++) {
+                chip8.set_key(key, (keys >> key) & 1);
             }
         }
+        play_tone(false);
+        return;
+    }
+
+    {
+        CHIP8_PROFILE_SCOPE(emulate);
+        auto frame = clock.next_frame();
+        [[maybe_unused]] auto idle = chip8.get_idle_cycles();
+        emulate(frame);
+        CHIP8_PROFILE_CYCLES(frame.cycles);
+        CHIP8_PROFILE_IDLE_CYCLES(chip8.get_idle_cycles() - idle);
+    }
+
+    if (turbo) {
+        return;
+    }
+
+    play_tone(chip8.sound_on());
+
+    if (rewind) {
+        remember();
+    }
+}
+
+// Runs frames back to back until the frame skip lets one be presented. Input is polled once,
+// before the first frame. The timers still tick once per emulated frame, so emulated time
+// only runs faster. The beeper stays silent and the rewind history only gets the presented
+// frames.
+void Engine::fast_forward() {
+    update();
+    events.clear();
+    while (frontend->running && !frame_skip.due()) {
+        step();
+        if (video) {
+            video->push(chip8.get_display());
+        }
+    }
+
+    play_tone(false);
+    if (rewind && !rewinding) {
+        remember();
+    }
+
+    auto start = FrameSkip::clock::now();
+    draw();
+    frame_skip.presented(FrameSkip::clock::now() - start);
+}
+
+// Appends the state at the end of the frame to the rewind history.
+void Engine::remember() {
+    chip8.save(snapshot);
+    if (extended_snapshot) {
+        chip8.save(*extended_snapshot);
+    }
+    rewind->push(snapshot, extended_snapshot.get());
+}
+
+// Sounds or silences the beeper for one frame. In threaded mode the render thread plays it.
+// A tone that does not fit into the queue is dropped, the beeper catches up with the next.
+void Engine::play_tone(bool on) {
+    auto seconds = 1.0 / clock.get_fps();
+    if (tone_queue) {
+        tone_queue->push({on, seconds});
+    } else {
+        frontend->play_tone(on, seconds);
+    }
+}
+
+// Ends the run. In threaded mode the render thread stops the frontend.
+void Engine::stop() {
+    if (tone_queue) {
+        finished.store(true, std::memory_order_release);
+    } else {
+        frontend->running = false;
+    }
+}
+
+// Runs a frame with its key changes spread over the cycles. The events happened between the
+// previous poll and this one, so each is applied at the cycle that lies as far into the frame
+// as the event lay into that interval. This keeps the spacing of quick taps instead of
+// applying every change before the first cycle.
+void Engine::emulate(Clock::Frame frame) {
+    auto start = previous_poll;
+    auto interval = std::chrono::duration<double>(last_poll - start).count();
+
+    chip8.run_frame({0, frame.timer_ticks});
+    auto done = 0;
+    for (auto& event : events) {
+        auto offset = interval > 0 ? std::chrono::duration<double>(event.time - start).count() / interval : 1.0;
+        auto cycle = static_cast<int>(frame.cycles * std::clamp(offset, 0.0, 1.0));
+        if (cycle > done) {
+            chip8.run(cycle - done);
+            done = cycle;
+        }
+        chip8.set_key(event.key, event.pressed);
+    }
+    chip8.run(frame.cycles - done);
+}
+
+// Presents the current framebuffer.
+void Engine::draw() {
+    {
+        CHIP8_PROFILE_SCOPE(draw);
+        frontend->present(chip8.get_display());
+    }
+
+    latency.presented(inputs);
+}
+
+void Engine::Latency::input(std::chrono::steady_clock::time_point time, uint64_t index) {
+    if (!has_pending) {
+        pending = time;
+        pending_index = index;
+        has_pending = true;
+    }
+}
+
+void Engine::Latency::presented(uint64_t inputs) {
+    if (!has_pending || inputs <= pending_index) {
+        return;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - pending);
+    count++;
+    total += elapsed;
+    max = std::max(max, elapsed);
+    has_pending = false;
+#ifdef CHIP8_PROFILE
+    Profiler::get().record(Profiler::Phase::input, elapsed);
+#endif
+}
+
+void Engine::Latency::report(std::ostream& out) const {
+    if (count == 0) {
+        return;
     }
-    window.render();
+    out << "Input to present latency: mean " << total.count() / 1e6 / count << " ms, max " << max.count() / 1e6
+        << " ms over " << count << " inputs" << std::endl;
 }
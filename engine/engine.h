@@ -1,23 +1,158 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
 #include <string>
+#include <vector>
 
 #include "../core/chip8.h"
+#include "../core/clock.h"
 #include "../core/display.h"
-#include "window.h"
+#include "../core/movie.h"
+#include "capture.h"
+#include "frame_skip.h"
+#include "frontend.h"
+#include "rewind.h"
+#include "scheduler.h"
+#include "spsc_ring.h"
+#include "triple_buffer.h"
 
 class Engine {
    public:
-    [[nodiscard]] bool init(int cycles = 10, float fps = 60.0);
+    explicit Engine(std::unique_ptr<Frontend> frontend) : frontend(std::move(frontend)) {}
+
+    [[nodiscard]] bool init(int cpu_hz = 600, float fps = 60.0);
     void load_rom(std::string filename);
+    void set_execution_mode(ExecutionMode mode);
+    void seed(uint64_t value);
+
+    // Selects the machine the rom was written for. Takes effect with the next load_rom.
+    void set_variant(Variant variant);
+
+    // Records the input of the run into a movie file, written when the run ends.
+    void record(std::string filename);
+
+    // Replays a movie file instead of reading input, and stops at its end. Call before
+    // load_rom, since the movie selects the variant.
+    void replay(std::string filename);
+
+    // Continues from the machine state in a snapshot file instead of the start of the rom. Call
+    // after load_rom. The snapshot must be of the same variant.
+    void load_state(std::string filename);
+
+    // Writes the machine state into a snapshot file when the run ends.
+    void save_state(std::string filename);
+
+    // Records every emulated frame into a video file, see Capture. Call after replay, since
+    // the movie sets the frame rate.
+    void capture(std::string filename);
+
+    // Shows live statistics once per second. Needs a build with CHIP8_PROFILE.
+    void show_stats(bool enabled);
+
+    // Runs as fast as the host allows, presenting every skip-th frame, or with a skip of 0 as
+    // many frames as the cost of presenting allows. Frontends may toggle turbo themselves.
+    void set_turbo(bool enabled, int skip = 0);
+
+    // Runs the emulation on its own thread for realtime frontends, so that slow presents do
+    // not hold it up. The calling thread polls input and presents.
+    void set_threaded(bool enabled);
+
     void start();
 
+    // Runs one frame of input and emulation.
+    void update();
+
+    // Presents the current framebuffer.
+    void draw();
+
    private:
-    int cycles_per_second;
-    float frames_per_second;
+    Clock clock;
+    Scheduler scheduler;
     Chip8 chip8;
-    Window window;
+    std::unique_ptr<Frontend> frontend;
 
-    void update();
-    void draw();
-};
\ No newline at end of file
+    // History for rewinding, only kept for realtime frontends
+    std::unique_ptr<Rewind> rewind;
+    MachineState snapshot;
+    std::unique_ptr<ExtendedState> extended_snapshot;  // Only for XO-CHIP
+
+    // Movie being recorded or replayed
+    std::unique_ptr<Movie> movie;
+    std::unique_ptr<MoviePlayer> player;
+    std::string movie_path;
+
+    // Snapshot written when the run ends
+    std::string state_path;
+
+    // Video being captured
+    std::unique_ptr<Capture> video;
+
+    bool stats = false;
+    bool threaded = false;
+
+    FrameSkip frame_skip;
+    int turbo_skip = 0;  // Fixed interval of the frame skip, 0 to adapt it
+
+    // Input of the current frame, the time of its poll and of the poll before it
+    std::vector<KeyEvent> events;
+    std::chrono::steady_clock::time_point last_poll;
+    std::chrono::steady_clock::time_point previous_poll;
+    uint64_t inputs = 0;  // Key changes taken in since the start
+
+    // Frontend flags as seen by the emulation, updated at every poll
+    bool rewinding = false;
+    bool turbo = false;
+
+    // Time from the oldest key change that is not on screen yet to the present that shows it.
+    // Key changes are numbered in the order they are taken in.
+    struct Latency {
+        std::chrono::steady_clock::time_point pending;
+        uint64_t pending_index = 0;
+        bool has_pending = false;
+        uint64_t count = 0;
+        std::chrono::nanoseconds total{0};
+        std::chrono::nanoseconds max{0};
+
+        void input(std::chrono::steady_clock::time_point time, uint64_t index);
+
+        // Takes a present of a frame that includes the given number of key changes.
+        void presented(uint64_t inputs);
+
+        void report(std::ostream& out) const;
+    } latency;
+
+    // Channels between the render thread and the emulation thread in threaded mode. Only the
+    // render thread uses the frontend: the emulation thread sends it the beeper tones and
+    // whether the run finished.
+    struct Frame {
+        Display display;
+        uint64_t inputs = 0;
+    };
+    struct Tone {
+        bool on = false;
+        double seconds = 0.0;
+    };
+    enum Control : uint8_t { control_running = 1, control_rewinding = 2, control_turbo = 4 };
+    std::unique_ptr<TripleBuffer<Frame>> frames;
+    std::unique_ptr<SpscRing<KeyEvent, 256>> input_queue;
+    std::unique_ptr<SpscRing<Tone, 256>> tone_queue;
+    std::atomic<uint8_t> controls{0};
+    std::atomic<bool> finished{false};
+
+    void run_frames();
+    void run_threads();
+    void emulation_loop();
+    void render_loop();
+    uint8_t control_flags() const;
+    void poll();
+    void step();
+    void emulate(Clock::Frame frame);
+    void fast_forward();
+    void remember();
+    void play_tone(bool on);
+    void stop();
+};
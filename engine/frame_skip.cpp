@@ -0,0 +1,32 @@
+#include "frame_skip.h"
+
+#include <algorithm>
+
+FrameSkip::FrameSkip(int interval, double budget, double max_fps)
+    : interval(interval),
+      budget(budget),
+      min_gap(std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / max_fps))) {
+    reset();
+}
+
+bool FrameSkip::due() {
+    frames++;
+    auto present = interval > 0 ? frames >= interval : frames % check_interval == 0 && clock::now() >= next;
+    if (!present) {
+        skipped_count++;
+    }
+    return present;
+}
+
+// A present that took t leaves t * (1 - budget) / budget of host time to emulation before the
+// next one.
+void FrameSkip::presented(clock::duration cost) {
+    frames = 0;
+    auto gap = std::chrono::duration_cast<clock::duration>(cost * ((1.0 - budget) / budget));
+    next = clock::now() + std::max(gap, min_gap);
+}
+
+void FrameSkip::reset() {
+    frames = 0;
+    next = clock::now();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+
+// Picks the frames that are presented while fast-forwarding. With a fixed interval every Nth
+// frame is presented. Otherwise frames are presented as often as the time spent presenting
+// stays below the given share of host time, and no more often than the display rate.
+class FrameSkip {
+   public:
+    using clock = std::chrono::steady_clock;
+
+    // An interval of 0 adapts the skip to the cost of presenting.
+    explicit FrameSkip(int interval = 0, double budget = 0.1, double max_fps = 60.0);
+
+    // Counts a frame and returns whether it should be presented.
+    bool due();
+
+    // Takes the time the present of a due frame took.
+    void presented(clock::duration cost);
+
+    void reset();
+
+    // Returns the number of frames skipped since the start.
+    long skipped() const {
+        return skipped_count;
+    }
+
+   private:
+    // Frames between reads of the clock in the adaptive mode
+    static constexpr int check_interval = 8;
+
+    int interval;
+    double budget;
+    clock::duration min_gap;
+
+    int frames = 0;
+    clock::time_point next;
+    long skipped_count = 0;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../core/chip8.h"
+#include "../core/display.h"
+
+// A change of a chip8 key, stamped with the time the host saw it.
+struct KeyEvent {
+    std::chrono::steady_clock::time_point time;
+    uint8_t key;  // 0x0 to 0xF
+    bool pressed;
+};
+
+// Presents the emulator to the host: input, output and the lifetime of the run.
+class Frontend {
+   public:
+    // ARGB colors of the pixels by their plane bits, see Display::expand
+    static constexpr std::array<uint32_t, 4> palette = {0xFF000000, 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555};
+
+    bool running = false;
+    bool rewinding = false;  // Step backwards through the history instead of running
+    bool turbo = false;      // Run unpaced and present only some of the frames
+
+    virtual ~Frontend() = default;
+
+    [[nodiscard]] virtual bool init(int width, int height, std::string title) = 0;
+
+    // Appends the key changes since the previous poll in the order they happened.
+    virtual void poll_events(std::vector<KeyEvent>& events) = 0;
+
+    // Shows a finished frame.
+    virtual void present(const Display& display) = 0;
+
+    // Sounds or silences the beeper for a frame of the given length.
+    virtual void play_tone(bool, double) {}
+
+    // Shows a line of performance statistics.
+    virtual void show_stats(const std::string& text) {
+        std::cerr << text << std::endl;
+    }
+
+    // Returns whether frames have to be paced against the wall clock.
+    virtual bool realtime() const {
+        return true;
+    }
+
+    // Returns whether present() blocks until the next vertical blank.
+    virtual bool vsync() const {
+        return false;
+    }
+};
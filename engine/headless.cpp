@@ -0,0 +1,15 @@
+#include "headless.h"
+
+bool Headless::init(int, int, std::string) {
+    frame_count = 0;
+    running = true;
+    return true;
+}
+
+// There is no input to poll, only count the frame and stop once the limit is reached.
+void Headless::poll_events(std::vector<KeyEvent>&) {
+    frame_count++;
+    if (max_frames > 0 && frame_count >= max_frames) {
+        running = false;
+    }
+}
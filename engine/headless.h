@@ -0,0 +1,27 @@
+#pragma once
+
+#include "frontend.h"
+
+// Frontend without any output. Runs unpaced until the frame limit is reached.
+class Headless : public Frontend {
+   public:
+    // A frame limit of 0 runs forever.
+    explicit Headless(long max_frames = 0) : max_frames(max_frames) {}
+
+    [[nodiscard]] bool init(int width, int height, std::string title) override;
+
+    void poll_events(std::vector<KeyEvent>& events) override;
+    void present(const Display&) override {}
+
+    bool realtime() const override {
+        return false;
+    }
+
+    long frames() const {
+        return frame_count;
+    }
+
+   private:
+    long max_frames;
+    long frame_count = 0;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// Binds physical keys to the 16 keys of the chip8 keypad. Keys are bound by scancode, so the
+// layout stays in place on every keyboard layout.
+class Keymap {
+   public:
+    // The left side of a QWERTY keyboard, in the shape of the original keypad:
+    //   1 2 3 4        1 2 3 C
+    //   Q W E R   ->   4 5 6 D
+    //   A S D F        7 8 9 E
+    //   Z X C V        A 0 B F
+    Keymap() {
+        keys.fill(-1);
+        const SDL_Scancode layout[0x10] = {
+            SDL_SCANCODE_X, SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3, SDL_SCANCODE_Q, SDL_SCANCODE_W,
+            SDL_SCANCODE_E, SDL_SCANCODE_A, SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_Z, SDL_SCANCODE_C,
+            SDL_SCANCODE_4, SDL_SCANCODE_R, SDL_SCANCODE_F, SDL_SCANCODE_V,
+        };
+        for (auto key = 0; key < 0x10; key++) {
+            bind(layout[key], key);
+        }
+    }
+
+    void bind(SDL_Scancode scancode, int key) {
+        if (scancode > SDL_SCANCODE_UNKNOWN && scancode < SDL_NUM_SCANCODES) {
+            keys[scancode] = static_cast<int8_t>(key);
+        }
+    }
+
+    // Returns the chip8 key bound to the scancode, or -1 if it is not bound.
+    int lookup(SDL_Scancode scancode) const {
+        if (scancode < 0 || scancode >= SDL_NUM_SCANCODES) {
+            return -1;
+        }
+        return keys[scancode];
+    }
+
+    // Parses a list of 16 key names separated by commas, for chip8 keys 0 to F in order, such
+    // as "X,1,2,3,Q,W,E,A,S,D,Z,C,4,R,F,V". Names are the ones of SDL_GetScancodeFromName. A
+    // string of exactly 16 characters is also accepted, one character per key.
+    static Keymap parse(const std::string& text) {
+        std::array<std::string, 0x10> names;
+        if (text.size() == 0x10 && text.find(',') == std::string::npos) {
+            for (auto key = 0; key < 0x10; key++) {
+                names[key] = text.substr(key, 1);
+            }
+        } else {
+            std::size_t start = 0;
+            for (auto key = 0; key < 0x10; key++) {
+                auto end = text.find(',', start);
+                if ((end == std::string::npos) != (key == 0x0F)) {
+                    throw std::runtime_error("Expected 16 keys!\n");
+                }
+                names[key] = text.substr(start, end - start);
+                start = end + 1;
+            }
+        }
+
+        Keymap keymap;
+        keymap.keys.fill(-1);
+        for (auto key = 0; key < 0x10; key++) {
+            auto scancode = SDL_GetScancodeFromName(names[key].c_str());
+            if (scancode == SDL_SCANCODE_UNKNOWN) {
+                throw std::runtime_error("Unknown key " + names[key] + "!\n");
+            }
+            keymap.bind(scancode, key);
+        }
+        return keymap;
+    }
+
+   private:
+    std::array<int8_t, SDL_NUM_SCANCODES> keys;
+};
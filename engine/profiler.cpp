@@ -0,0 +1,175 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+int log2(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    auto result = 0;
+    while (value >>= 1) {
+        result++;
+    }
+    return result;
+#endif
+}
+
+double ms(uint64_t ns) {
+    return ns / 1e6;
+}
+
+double us(uint64_t ns) {
+    return ns / 1e3;
+}
+
+}  // namespace
+
+// Values below 2^sub_bits get a bucket each. Above, the exponent selects a group of buckets
+// and the bits below the leading one select the bucket in the group.
+int Profiler::Histogram::bucket(uint64_t ns) {
+    if (ns < sub_buckets) {
+        return static_cast<int>(ns);
+    }
+    auto exponent = log2(ns);
+    auto sub = static_cast<int>((ns >> (exponent - sub_bits)) & (sub_buckets - 1));
+    return std::min((exponent - sub_bits + 1) * sub_buckets + sub, buckets - 1);
+}
+
+uint64_t Profiler::Histogram::lower_bound(int bucket) {
+    if (bucket < sub_buckets) {
+        return bucket;
+    }
+    auto exponent = bucket / sub_buckets + sub_bits - 1;
+    auto sub = static_cast<uint64_t>(bucket % sub_buckets);
+    return (uint64_t(1) << exponent) | (sub << (exponent - sub_bits));
+}
+
+void Profiler::Histogram::record(uint64_t ns) {
+    values[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+Profiler::Histogram::Counts Profiler::Histogram::counts() const {
+    Counts counts;
+    for (auto i = 0; i < buckets; i++) {
+        counts[i] = values[i].load(std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+uint64_t Profiler::Histogram::quantile(const Counts& counts, double q) {
+    uint64_t total = 0;
+    for (auto count : counts) {
+        total += count;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    auto rank = static_cast<uint64_t>(q * (total - 1));
+    uint64_t seen = 0;
+    for (auto i = 0; i < buckets; i++) {
+        seen += counts[i];
+        if (seen > rank) {
+            return lower_bound(i);
+        }
+    }
+    return lower_bound(buckets - 1);
+}
+
+Profiler& Profiler::get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::record(Phase phase, clock::duration duration) {
+    auto ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    auto& counter = counters[static_cast<int>(phase)];
+    counter.count.fetch_add(1, std::memory_order_relaxed);
+    counter.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    auto max = counter.max_ns.load(std::memory_order_relaxed);
+    while (ns > max && !counter.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+    counter.histogram.record(ns);
+}
+
+void Profiler::add_cycles(uint64_t count) {
+    cycles.fetch_add(count, std::memory_order_relaxed);
+}
+
+void Profiler::add_idle_cycles(uint64_t count) {
+    idle_cycles.fetch_add(count, std::memory_order_relaxed);
+}
+
+std::string Profiler::readout() {
+    auto now = clock::now();
+    auto seconds = std::chrono::duration<double>(now - last_readout).count();
+    auto total = cycles.load(std::memory_order_relaxed);
+    auto mips = seconds > 0 ? (total - last_cycles) / seconds / 1e6 : 0.0;
+
+    auto interval = [](const Histogram& histogram, Histogram::Counts& last) {
+        auto counts = histogram.counts();
+        auto current = counts;
+        for (auto i = 0; i < Histogram::buckets; i++) {
+            counts[i] -= last[i];
+        }
+        last = current;
+        return counts;
+    };
+    auto frame = interval(counters[static_cast<int>(Phase::frame)].histogram, last_frame);
+    auto draw = interval(counters[static_cast<int>(Phase::draw)].histogram, last_draw);
+
+    last_readout = now;
+    last_cycles = total;
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "%.2f MIPS, frame p50 %.2f ms p99 %.2f ms, present p50 %.2f ms p99 %.2f ms", mips,
+                  ms(Histogram::quantile(frame, 0.5)), ms(Histogram::quantile(frame, 0.99)),
+                  ms(Histogram::quantile(draw, 0.5)), ms(Histogram::quantile(draw, 0.99)));
+    return line;
+}
+
+// Times are in microseconds, since most phases take far less than a millisecond.
+void Profiler::report(std::ostream& out) const {
+    out << "Phase        count   mean us    p50 us    p99 us    max us" << std::endl;
+    for (auto i = 0; i < static_cast<int>(Phase::count); i++) {
+        auto& counter = counters[i];
+        auto count = counter.count.load(std::memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+        auto counts = counter.histogram.counts();
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-10s %7llu %9.2f %9.2f %9.2f %9.2f", name(static_cast<Phase>(i)),
+                      static_cast<unsigned long long>(count), us(counter.total_ns.load(std::memory_order_relaxed)) / count,
+                      us(Histogram::quantile(counts, 0.5)), us(Histogram::quantile(counts, 0.99)),
+                      us(counter.max_ns.load(std::memory_order_relaxed)));
+        out << line << std::endl;
+    }
+    out << "Cycles: " << cycles.load(std::memory_order_relaxed) << " (" << idle_cycles.load(std::memory_order_relaxed)
+        << " skipped in wait loops)" << std::endl;
+}
+
+const char* Profiler::name(Phase phase) {
+    switch (phase) {
+        case Phase::frame:
+            return "frame";
+        case Phase::wait:
+            return "wait";
+        case Phase::poll:
+            return "poll";
+        case Phase::emulate:
+            return "emulate";
+        case Phase::draw:
+            return "draw";
+        case Phase::upload:
+            return "upload";
+        case Phase::render:
+            return "render";
+        case Phase::input:
+            return "input";
+        default:
+            return "";
+    }
+}
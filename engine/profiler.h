@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Host side instrumentation of the frame loop. Scopes time the phases of a frame into
+// lock-free histograms, which any thread may record into while another reads them.
+//
+// Everything is compiled out unless CHIP8_PROFILE is defined: the macros below expand to
+// nothing and no clock is read.
+class Profiler {
+   public:
+    using clock = std::chrono::steady_clock;
+
+    enum class Phase { frame, wait, poll, emulate, draw, upload, render, input, count };
+
+    // Latency histogram with logarithmic buckets that are each split into linear sub-buckets,
+    // so every recorded value is within 1/16 of its bucket. Covers 1 ns to about 18 minutes.
+    class Histogram {
+       public:
+        static constexpr int sub_bits = 4;
+        static constexpr int sub_buckets = 1 << sub_bits;
+        static constexpr int buckets = (41 - sub_bits) * sub_buckets;
+
+        using Counts = std::array<uint64_t, buckets>;
+
+        void record(uint64_t ns);
+        Counts counts() const;
+
+        // Returns the lower bound of the bucket that holds the given quantile, or 0 without
+        // samples.
+        static uint64_t quantile(const Counts& counts, double q);
+
+       private:
+        std::array<std::atomic<uint64_t>, buckets> values = {};
+
+        static int bucket(uint64_t ns);
+        static uint64_t lower_bound(int bucket);
+    };
+
+    static Profiler& get();
+
+    void record(Phase phase, clock::duration duration);
+    void add_cycles(uint64_t cycles);
+    void add_idle_cycles(uint64_t cycles);
+
+    // Returns a one line summary of the time since the previous call: emulated MIPS and the
+    // median and 99th percentile frame and present times.
+    std::string readout();
+
+    // Writes count, mean and percentiles of every phase since the start.
+    void report(std::ostream& out) const;
+
+    static const char* name(Phase phase);
+
+   private:
+    struct alignas(64) Counter {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+        Histogram histogram;
+    };
+
+    std::array<Counter, static_cast<int>(Phase::count)> counters;
+    alignas(64) std::atomic<uint64_t> cycles{0};
+    std::atomic<uint64_t> idle_cycles{0};  // Part of cycles, skipped in wait loops
+
+    // State of the previous readout
+    clock::time_point last_readout = clock::now();
+    uint64_t last_cycles = 0;
+    Histogram::Counts last_frame = {};
+    Histogram::Counts last_draw = {};
+};
+
+// Times the enclosing scope as the given phase.
+class ProfileScope {
+   public:
+    explicit ProfileScope(Profiler::Phase phase) : phase(phase), start(Profiler::clock::now()) {}
+
+    ~ProfileScope() {
+        Profiler::get().record(phase, Profiler::clock::now() - start);
+    }
+
+   private:
+    Profiler::Phase phase;
+    Profiler::clock::time_point start;
+};
+
+#ifdef CHIP8_PROFILE
+#define CHIP8_PROFILE_CONCAT_(a, b) a##b
+#define CHIP8_PROFILE_CONCAT(a, b) CHIP8_PROFILE_CONCAT_(a, b)
+#define CHIP8_PROFILE_SCOPE(phase) ProfileScope CHIP8_PROFILE_CONCAT(profile_scope_, __LINE__)(Profiler::Phase::phase)
+#define CHIP8_PROFILE_CYCLES(n) Profiler::get().add_cycles(n)
+#define CHIP8_PROFILE_IDLE_CYCLES(n) Profiler::get().add_idle_cycles(n)
+#else
+#define CHIP8_PROFILE_SCOPE(phase)
+#define CHIP8_PROFILE_CYCLES(n)
+#define CHIP8_PROFILE_IDLE_CYCLES(n)
+#endif
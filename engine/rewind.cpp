@@ -0,0 +1,249 @@
+#include "rewind.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+constexpr std::size_t state_size = sizeof(MachineState);
+constexpr std::size_t extended_size = sizeof(ExtendedState);
+
+// Bound on the size of encode(), for a state of the given size
+constexpr std::size_t encoded_bound(std::size_t size) {
+    return 2 * size + 16;
+}
+
+static_assert(encoded_bound(state_size) <= 0xFFFF, "Entry::split must hold an encoded MachineState");
+
+// Reference for keyframes, which are encoded against an all zero state
+const std::array<uint8_t, std::max(state_size, extended_size)> zeros = {0};
+
+void write_varint(uint8_t*& out, std::size_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+}
+
+std::size_t read_varint(const uint8_t*& in) {
+    std::size_t value = 0;
+    for (auto shift = 0;; shift += 7) {
+        auto byte = *in++;
+        value |= static_cast<std::size_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
+
+}  // namespace
+
+Rewind::Rewind(std::size_t budget, int max_frames, int keyframe_interval)
+    : ring(budget), entries(std::max(max_frames, 2)), keyframe_interval(std::max(keyframe_interval, 1)) {
+    scratch.resize(encoded_bound(state_size));
+}
+
+void Rewind::push(const MachineState& state, const ExtendedState* extended) {
+    auto bytes = reinterpret_cast<const uint8_t*>(&state);
+    auto keyframe = count == 0 || since_keyframe + 1 >= keyframe_interval;
+    if (extended != nullptr && !base_extended) {
+        base_extended = std::make_unique<ExtendedState>();
+        scratch.resize(encoded_bound(state_size) + encoded_bound(extended_size));
+    }
+
+    for (;;) {
+        auto reference = keyframe ? zeros.data() : reinterpret_cast<const uint8_t*>(&base);
+        auto split = encode(bytes, reference, state_size, scratch.data());
+        auto size = split;
+        if (extended != nullptr) {
+            auto extended_reference = keyframe ? zeros.data() : base_extended->memory.data();
+            size += encode(extended->memory.data(), extended_reference, extended_size, scratch.data() + split);
+        }
+
+        std::size_t offset;
+        if (!reserve(size, offset)) {
+            // A single record larger than the budget, keep no history at all
+            clear();
+            return;
+        }
+        // Making room dropped the keyframe of this delta
+        if (!keyframe && count == 0) {
+            keyframe = true;
+            continue;
+        }
+
+        std::memcpy(ring.data() + offset, scratch.data(), size);
+        head = offset + size;
+        entries[(first + count) % entries.size()] = {static_cast<uint32_t>(offset), static_cast<uint32_t>(size),
+                                                     static_cast<uint16_t>(split), keyframe};
+        count++;
+
+        if (keyframe) {
+            base = state;
+            if (extended != nullptr) {
+                *base_extended = *extended;
+            }
+            since_keyframe = 0;
+        } else {
+            since_keyframe++;
+        }
+        return;
+    }
+}
+
+bool Rewind::step_back(MachineState& state, ExtendedState* extended) {
+    if (count < 2) {
+        return false;
+    }
+
+    auto dropped = entry(count - 1);
+    count--;
+    head = dropped.offset;
+
+    if (dropped.keyframe) {
+        restore_base();
+    } else {
+        since_keyframe--;
+    }
+
+    decode(entry(count - 1), state, extended);
+    return true;
+}
+
+void Rewind::clear() {
+    head = 0;
+    first = 0;
+    count = 0;
+    since_keyframe = 0;
+    base_extended.reset();
+}
+
+std::size_t Rewind::bytes_used() const {
+    std::size_t used = 0;
+    for (auto i = 0; i < count; i++) {
+        used += entries[(first + i) % entries.size()].size;
+    }
+    return used;
+}
+
+// Finds space for a record of the given size after the newest one, dropping the oldest
+// frames as needed. Returns false if the record can never fit.
+bool Rewind::reserve(std::size_t size, std::size_t& offset) {
+    if (size > ring.size()) {
+        return false;
+    }
+
+    for (;; drop_oldest_keyframe()) {
+        if (count == 0) {
+            offset = 0;
+            return true;
+        }
+        if (count == static_cast<int>(entries.size())) {
+            continue;
+        }
+
+        // Live records run from tail to head, possibly wrapping around the end of the ring
+        std::size_t tail = entry(0).offset;
+        if (head > tail) {
+            if (head + size <= ring.size()) {
+                offset = head;
+                return true;
+            }
+            if (size <= tail) {
+                offset = 0;
+                return true;
+            }
+        } else if (head < tail && head + size <= tail) {
+            offset = head;
+            return true;
+        }
+    }
+}
+
+// Drops the oldest keyframe and the deltas that depend on it.
+void Rewind::drop_oldest_keyframe() {
+    do {
+        first = (first + 1) % entries.size();
+        count--;
+    } while (count > 0 && !entry(0).keyframe);
+}
+
+void Rewind::decode(const Entry& entry, MachineState& state, ExtendedState* extended) const {
+    auto bytes = reinterpret_cast<uint8_t*>(&state);
+    if (entry.keyframe) {
+        std::fill(bytes, bytes + state_size, 0);
+    } else {
+        std::memcpy(bytes, &base, state_size);
+    }
+    apply(ring.data() + entry.offset, entry.split, bytes);
+
+    if (extended == nullptr || !base_extended) {
+        return;
+    }
+    if (entry.keyframe) {
+        extended->memory.fill(0);
+    } else {
+        *extended = *base_extended;
+    }
+    apply(ring.data() + entry.offset + entry.split, entry.size - entry.split, extended->memory.data());
+}
+
+// Decodes the newest remaining keyframe into the base, after the one before it was dropped.
+void Rewind::restore_base() {
+    auto index = count - 1;
+    while (!entry(index).keyframe) {
+        index--;
+    }
+    decode(entry(index), base, base_extended.get());
+    since_keyframe = count - 1 - index;
+}
+
+// Encodes the XOR of a state against a reference as runs of unchanged and changed bytes:
+// a varint count of bytes to skip, a varint count of changed bytes, then the changed bytes
+// XORed with the reference. Returns the size of the encoding, at most encoded_bound(size).
+std::size_t Rewind::encode(const uint8_t* state, const uint8_t* reference, std::size_t size, uint8_t* out) {
+    auto cursor = out;
+    auto delta = [&](std::size_t i) { return static_cast<uint8_t>(state[i] ^ reference[i]); };
+
+    std::size_t i = 0;
+    while (i < size) {
+        auto start = i;
+        while (i + 8 <= size && std::memcmp(state + i, reference + i, 8) == 0) {
+            i += 8;
+        }
+        while (i < size && delta(i) == 0) {
+            i++;
+        }
+        if (i == size) {
+            break;
+        }
+
+        // A single unchanged byte is cheaper to store than a new run
+        auto changed = i;
+        while (i < size && (delta(i) != 0 || (i + 1 < size && delta(i + 1) != 0))) {
+            i++;
+        }
+
+        write_varint(cursor, changed - start);
+        write_varint(cursor, i - changed);
+        for (auto j = changed; j < i; j++) {
+            *cursor++ = delta(j);
+        }
+    }
+    return cursor - out;
+}
+
+// XORs an encoding from encode() onto a state.
+void Rewind::apply(const uint8_t* in, std::size_t size, uint8_t* state) {
+    auto end = in + size;
+    std::size_t position = 0;
+    while (in < end) {
+        position += read_varint(in);
+        auto length = read_varint(in);
+        for (std::size_t i = 0; i < length; i++) {
+            state[position++] ^= *in++;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../core/state.h"
+
+// History of machine states for stepping backwards frame by frame, in a fixed memory budget.
+//
+// Every frame is stored as the XOR of its state against the last keyframe, run-length
+// encoded. Most frames only change a few bytes, so a delta usually takes a few dozen bytes
+// instead of the full state. Records live in a ring of bytes that is allocated once; when it
+// is full the oldest keyframe is dropped together with its deltas. The extended state of
+// XO-CHIP machines is stored the same way after the machine state, and only for them.
+class Rewind {
+   public:
+    // Keeps up to max_frames frames in at most budget bytes. A keyframe is stored every
+    // keyframe_interval frames.
+    explicit Rewind(std::size_t budget = 8 << 20, int max_frames = 60 * 60 * 10, int keyframe_interval = 120);
+
+    // Appends the state at the end of a frame. The extended state is given for every frame
+    // of an XO-CHIP machine and for no frame of the others.
+    void push(const MachineState& state, const ExtendedState* extended = nullptr);
+
+    // Drops the newest frame and restores the one before it. Returns false if there is no
+    // earlier frame.
+    bool step_back(MachineState& state, ExtendedState* extended = nullptr);
+
+    void clear();
+
+    int frames() const {
+        return count;
+    }
+
+    std::size_t bytes_used() const;
+
+   private:
+    struct Entry {
+        uint32_t offset;
+        uint32_t size;
+        uint16_t split;  // Size of the machine state part, the extended state follows
+        bool keyframe;
+    };
+
+    std::vector<uint8_t> ring;
+    std::size_t head = 0;  // Where the next record is written
+
+    // Ring of records, oldest at first
+    std::vector<Entry> entries;
+    int first = 0;
+    int count = 0;
+
+    int keyframe_interval;
+    int since_keyframe = 0;  // Deltas stored after the newest keyframe
+
+    MachineState base;                // The newest keyframe, which deltas are taken against
+    std::unique_ptr<ExtendedState> base_extended;
+    std::vector<uint8_t> scratch;     // Encoded record before it is copied into the ring
+
+    Entry& entry(int index) {
+        return entries[(first + index) % entries.size()];
+    }
+
+    bool reserve(std::size_t size, std::size_t& offset);
+    void drop_oldest_keyframe();
+    void decode(const Entry& entry, MachineState& state, ExtendedState* extended) const;
+    void restore_base();
+
+    static std::size_t encode(const uint8_t* state, const uint8_t* reference, std::size_t size, uint8_t* out);
+    static void apply(const uint8_t* in, std::size_t size, uint8_t* state);
+};
@@ -0,0 +1,129 @@
+#include "runner.h"
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "../core/chip8.h"
+#include "../core/clock.h"
+
+namespace {
+
+uint64_t pack(uint32_t begin, uint32_t end) {
+    return static_cast<uint64_t>(begin) << 32 | end;
+}
+
+}  // namespace
+
+Runner::Runner(int threads) : threads(threads) {
+    if (this->threads <= 0) {
+        this->threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+// Splits the jobs evenly across the workers, which rebalance by stealing from each other.
+std::vector<Runner::Result> Runner::run(const std::vector<Job>& jobs) {
+    std::vector<Result> results(jobs.size());
+    std::vector<Queue> queues(threads);
+
+    auto count = jobs.size();
+    for (auto i = 0; i < threads; i++) {
+        auto begin = count * i / threads;
+        auto end = count * (i + 1) / threads;
+        queues[i].range.store(pack(begin, end), std::memory_order_relaxed);
+    }
+
+    std::vector<std::thread> pool;
+    for (auto i = 1; i < threads; i++) {
+        pool.emplace_back(&Runner::worker, this, std::ref(queues), i, std::cref(jobs), std::ref(results));
+    }
+    worker(queues, 0, jobs, results);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    return results;
+}
+
+// Runs jobs from the own queue, then steals from the others until all queues are empty.
+// Every job writes only its own result slot.
+void Runner::worker(std::vector<Queue>& queues, int self, const std::vector<Job>& jobs, std::vector<Result>& results) {
+    auto& own = queues[self];
+    for (;;) {
+        uint32_t job;
+        while (pop(own, job)) {
+            results[job] = execute(jobs[job]);
+        }
+
+        auto stolen = false;
+        for (std::size_t i = 1; i < queues.size() && !stolen; i++) {
+            stolen = steal(queues[(self + i) % queues.size()], own);
+        }
+        if (!stolen) {
+            return;
+        }
+    }
+}
+
+bool Runner::pop(Queue& queue, uint32_t& job) {
+    auto range = queue.range.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t begin = range >> 32;
+        uint32_t end = range & 0xFFFFFFFF;
+        if (begin >= end) {
+            return false;
+        }
+        if (queue.range.compare_exchange_weak(range, pack(begin + 1, end), std::memory_order_acq_rel)) {
+            job = begin;
+            return true;
+        }
+    }
+}
+
+// Moves the back half of the victim's jobs to the empty queue of the thief. Only the thief
+// itself refills its queue, so a plain store is enough there.
+bool Runner::steal(Queue& victim, Queue& thief) {
+    auto range = victim.range.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t begin = range >> 32;
+        uint32_t end = range & 0xFFFFFFFF;
+        if (begin >= end) {
+            return false;
+        }
+        auto middle = begin + (end - begin) / 2;
+        if (victim.range.compare_exchange_weak(range, pack(begin, middle), std::memory_order_acq_rel)) {
+            thief.range.store(pack(middle, end), std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+// Runs one machine for the frames of the job.
+Runner::Result Runner::execute(const Job& job) {
+    Result result;
+    auto start = std::chrono::steady_clock::now();
+
+    try {
+        auto chip8 = std::make_unique<Chip8>();
+        chip8->set_execution_mode(job.mode);
+        chip8->set_variant(job.variant);
+        chip8->reset();
+        chip8->load_rom(*roms.load(job.rom));
+
+        Clock clock(job.cpu_hz, job.fps);
+        for (auto i = 0; i < job.frames; i++) {
+            auto frame = clock.next_frame();
+            chip8->run_frame(frame);
+            result.cycles += frame.cycles;
+        }
+
+        result.framebuffer_hash = chip8->get_display().hash();
+        result.ok = true;
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+
+    result.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
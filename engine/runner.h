@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../core/executor.h"
+#include "../core/rom.h"
+#include "../core/variant.h"
+
+// Runs many independent chip8 machines on a fixed pool of worker threads.
+class Runner {
+   public:
+    struct Job {
+        std::string rom;
+        long frames = 600;
+        int cpu_hz = 600;
+        float fps = 60.0;
+        ExecutionMode mode = ExecutionMode::Interpreter;
+        Variant variant = Variant::Chip8;
+    };
+
+    struct Result {
+        bool ok = false;
+        std::string error;
+        uint64_t framebuffer_hash = 0;  // See Display::hash
+        uint64_t cycles = 0;
+        double wall_ms = 0;
+    };
+
+    // 0 threads uses one per hardware thread.
+    explicit Runner(int threads = 0);
+
+    // Runs every job to completion. Results are in the order of the jobs.
+    std::vector<Result> run(const std::vector<Job>& jobs);
+
+    int get_threads() const {
+        return threads;
+    }
+
+   private:
+    // Range of job indices owned by one worker, begin in the upper and end in the lower half.
+    // The owner takes jobs from the front, idle workers steal the back half.
+    struct alignas(64) Queue {
+        std::atomic<uint64_t> range{0};
+    };
+
+    int threads;
+
+    // Every rom is read once and shared by all jobs that run it
+    RomCache roms;
+
+    void worker(std::vector<Queue>& queues, int self, const std::vector<Job>& jobs, std::vector<Result>& results);
+    static bool pop(Queue& queue, uint32_t& job);
+    static bool steal(Queue& victim, Queue& thief);
+    Result execute(const Job& job);
+};
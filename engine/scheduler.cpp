@@ -0,0 +1,71 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+Scheduler::Scheduler(double fps)
+    : period(std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / fps))) {
+    start();
+}
+
+void Scheduler::start() {
+    last = clock::now();
+    deadline = last + period;
+    frames = 0;
+    sum = sum_squares = min = max = 0;
+    late = 0;
+}
+
+// Sleeps until the deadline of the next frame. A frame that is more than a few periods late
+// moves the deadline instead of running the missed frames back to back.
+void Scheduler::wait() {
+    auto now = clock::now();
+    if (now < deadline) {
+        std::this_thread::sleep_until(deadline);
+        now = clock::now();
+    } else if (now - deadline > max_catch_up * period) {
+        late++;
+        deadline = now;
+    }
+    deadline += period;
+    record(now);
+}
+
+int Scheduler::due() {
+    auto now = clock::now();
+    auto count = 0;
+    while (deadline <= now && count < max_catch_up) {
+        deadline += period;
+        count++;
+    }
+    if (deadline <= now) {
+        late++;
+        deadline = now + period;
+    }
+    if (count > 0) {
+        record(now);
+    }
+    return count;
+}
+
+void Scheduler::record(clock::time_point now) {
+    double interval = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+    last = now;
+    min = frames == 0 ? interval : std::min(min, interval);
+    max = std::max(max, interval);
+    sum += interval;
+    sum_squares += interval * interval;
+    frames++;
+}
+
+// Writes frame time mean, jitter (standard deviation), extremes and late frames.
+void Scheduler::report(std::ostream& out) const {
+    if (frames == 0) {
+        return;
+    }
+    auto mean = sum / frames;
+    auto jitter = std::sqrt(std::max(0.0, sum_squares / frames - mean * mean));
+    out << "Frames: " << frames << ", frame time " << mean / 1e6 << " ms (jitter " << jitter / 1e6
+        << " ms, min " << min / 1e6 << " ms, max " << max / 1e6 << " ms), late: " << late << std::endl;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+
+// Paces frames against the steady clock and collects frame time statistics.
+class Scheduler {
+   public:
+    using clock = std::chrono::steady_clock;
+
+    explicit Scheduler(double fps = 60.0);
+
+    void start();
+
+    // Sleeps until the next frame is due.
+    void wait();
+
+    // Returns how many frames are due since the last call, for frontends whose present
+    // already blocks on vsync.
+    int due();
+
+    void report(std::ostream& out) const;
+
+   private:
+    // Frames further behind than this are dropped instead of caught up
+    static constexpr int max_catch_up = 4;
+
+    clock::duration period;
+    clock::time_point deadline;
+    clock::time_point last;
+
+    // Frame interval statistics in nanoseconds
+    long frames = 0;
+    double sum = 0;
+    double sum_squares = 0;
+    double min = 0;
+    double max = 0;
+    long late = 0;
+
+    void record(clock::time_point now);
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread. Neither
+// side ever blocks or allocates, so it is safe to use from realtime callbacks. The capacity
+// must be a power of two.
+template <typename T, std::size_t N>
+class SpscRing {
+    static_assert((N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+   public:
+    // Producer side. Returns false if the ring is full.
+    bool push(const T& value) {
+        auto head = write.load(std::memory_order_relaxed);
+        if (head - read_cache == N) {
+            read_cache = read.load(std::memory_order_acquire);
+            if (head - read_cache == N) {
+                return false;
+            }
+        }
+        slots[head & (N - 1)] = value;
+        write.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the ring is empty.
+    bool pop(T& value) {
+        auto tail = read.load(std::memory_order_relaxed);
+        if (tail == write_cache) {
+            write_cache = write.load(std::memory_order_acquire);
+            if (tail == write_cache) {
+                return false;
+            }
+        }
+        value = slots[tail & (N - 1)];
+        read.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Number of queued values. Exact only when called from the producer or the consumer while
+    // the other side is idle.
+    std::size_t size() const {
+        return write.load(std::memory_order_acquire) - read.load(std::memory_order_acquire);
+    }
+
+   private:
+    // Positions only ever grow, their difference is the fill level. Each side caches the
+    // position of the other to touch the shared cache line less often.
+    alignas(64) std::atomic<std::size_t> write{0};
+    std::size_t read_cache = 0;
+    alignas(64) std::atomic<std::size_t> read{0};
+    std::size_t write_cache = 0;
+    alignas(64) std::array<T, N> slots = {};
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Hands the newest value from exactly one producer thread to exactly one consumer thread
+// without locks. Each side owns one of three buffers and the third is swapped between them,
+// so the producer never waits for the consumer and the consumer always gets the newest
+// complete value. Values the consumer did not pick up in time are overwritten.
+template <typename T>
+class TripleBuffer {
+   public:
+    // Producer side. Returns the buffer to fill.
+    T& back() {
+        return buffers[back_index];
+    }
+
+    // Producer side. Makes the filled buffer the newest value and takes over a free one.
+    void publish() {
+        auto previous = middle.exchange(static_cast<uint8_t>(back_index | fresh), std::memory_order_acq_rel);
+        back_index = previous & index_mask;
+    }
+
+    // Consumer side. Takes over the newest value if one was published since the last call
+    // and returns whether it did.
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & fresh) == 0) {
+            return false;
+        }
+        auto previous = middle.exchange(front_index, std::memory_order_acq_rel);
+        front_index = previous & index_mask;
+        return true;
+    }
+
+    // Consumer side. Returns the value taken over by the last successful update().
+    const T& front() const {
+        return buffers[front_index];
+    }
+
+   private:
+    static constexpr uint8_t index_mask = 0x3;
+    static constexpr uint8_t fresh = 0x4;  // Set in middle when it holds an unread value
+
+    std::array<T, 3> buffers = {};
+
+    // Index of the swapped buffer, with the fresh bit
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t back_index = 0;
+    alignas(64) uint8_t front_index = 2;
+};
@@ -1,8 +1,14 @@
 #include "window.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
+#include "profiler.h"
+
 Window::~Window() {
+    beeper.close();
+    SDL_DestroyTexture(texture);
     SDL_DestroyWindow(window);
     SDL_DestroyRenderer(renderer);
     SDL_Quit();
@@ -15,50 +21,97 @@ bool Window::init(int width, int height, std::string title) {
         return false;
     }
 
-    SDL_CreateWindowAndRenderer(width, height, 0, &window, &renderer);
+    this->title = title;
+    window = SDL_CreateWindow(title.data(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_SHOWN);
+    if (window != nullptr) {
+        renderer = SDL_CreateRenderer(window, -1, use_vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+    }
     if (window == nullptr || renderer == nullptr) {
         std::cerr << "SDL Error: " << SDL_GetError() << std::endl;
         return false;
     }
 
-    SDL_SetWindowTitle(window, title.data());
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, Display::m_width, Display::m_height);
+    if (texture == nullptr) {
+        std::cerr << "SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    // Runs without sound if there is no audio device
+    beeper.open();
+
     running = true;
 
     return true;
 }
 
-// Poll for input.
-void Window::poll_events(Chip8* chip8) {
+// Polls for input. Chip8 keys are looked up by scancode and stamped with the time SDL saw
+// them, which is up to a frame before this poll.
+void Window::poll_events(std::vector<KeyEvent>& events) {
+    auto now = std::chrono::steady_clock::now();
+    auto ticks = SDL_GetTicks();
     SDL_Event event;
 
     while (SDL_PollEvent(&event) != 0) {
         if (event.type == SDL_QUIT) {
             running = false;
         }
-        if (event.type == SDL_KEYDOWN) {
-            if (event.key.keysym.sym == SDLK_ESCAPE) {
-                running = false;
-            }
-            chip8->set_key(event.key.keysym.sym, 1);
+        if (event.type != SDL_KEYDOWN && event.type != SDL_KEYUP) {
+            continue;
+        }
+
+        auto pressed = event.type == SDL_KEYDOWN;
+        if (event.key.keysym.sym == SDLK_ESCAPE && pressed) {
+            running = false;
+        }
+        if (event.key.keysym.sym == SDLK_BACKSPACE) {
+            rewinding = pressed;
         }
-        if (event.type == SDL_KEYUP) {
-            chip8->set_key(event.key.keysym.sym, 0);
+        if (event.key.keysym.sym == SDLK_TAB && pressed && event.key.repeat == 0) {
+            turbo = !turbo;
         }
+
+        auto key = keymap.lookup(event.key.keysym.scancode);
+        if (key < 0 || event.key.repeat != 0) {
+            continue;
+        }
+        auto age = std::chrono::milliseconds(ticks - std::min(ticks, event.key.timestamp));
+        events.push_back({now - age, static_cast<uint8_t>(key), pressed});
     }
 }
 
-void Window::render() {
+// Scales the framebuffer texture to the window. The texture is only uploaded if the
+// framebuffer changed since the last present.
+void Window::present(const Display& display) {
+    if (!has_upload || display != uploaded) {
+        CHIP8_PROFILE_SCOPE(upload);
+        upload(display);
+    }
+    CHIP8_PROFILE_SCOPE(render);
+    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
     SDL_RenderPresent(renderer);
 }
 
-void Window::clear_screen() {
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
-    SDL_RenderClear(renderer);
+void Window::play_tone(bool on, double seconds) {
+    beeper.play(on, seconds);
 }
 
-void Window::draw_pixel(int x, int y, int scale) {
-    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
-    SDL_Rect rect{x * scale, y * scale, scale, scale};
-    SDL_RenderDrawRect(renderer, &rect);
-    SDL_RenderFillRect(renderer, &rect);
+// Shows the statistics in the title bar.
+void Window::show_stats(const std::string& text) {
+    SDL_SetWindowTitle(window, (title + " - " + text).c_str());
+}
+
+// Expands the packed framebuffer into the texture in a single pass. The texture has the size
+// of the hi-res screen, lo-res pixels cover four texels.
+void Window::upload(const Display& display) {
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, nullptr, &pixels, &pitch) != 0) {
+        return;
+    }
+    display.expand(static_cast<uint32_t*>(pixels), pitch / static_cast<int>(sizeof(uint32_t)), palette);
+    SDL_UnlockTexture(texture);
+
+    uploaded = display;
+    has_upload = true;
 }
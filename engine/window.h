@@ -1,24 +1,42 @@
 #pragma once
 
 #include <SDL.h>
-#include "../core/chip8.h"
 
 #include <string>
 
-class Window {
+#include "beeper.h"
+#include "frontend.h"
+#include "keymap.h"
+
+class Window : public Frontend {
    public:
-    bool running = false;
+    explicit Window(bool vsync = false, Keymap keymap = {}) : use_vsync(vsync), keymap(keymap) {}
+    ~Window() override;
 
-    ~Window();
+    [[nodiscard]] bool init(int width, int height, std::string title) override;
 
-    [[nodiscard]] bool init(int width, int height, std::string title);
+    void poll_events(std::vector<KeyEvent>& events) override;
+    void present(const Display& display) override;
+    void play_tone(bool on, double seconds) override;
+    void show_stats(const std::string& text) override;
 
-    void poll_events(Chip8* chip8);
-    void render();
-    void clear_screen();
-    void draw_pixel(int x, int y, int scale);
+    bool vsync() const override {
+        return use_vsync;
+    }
 
    private:
+    bool use_vsync;
+    Keymap keymap;
+    std::string title;
     SDL_Window* window = nullptr;
     SDL_Renderer* renderer = nullptr;
-};
\ No newline at end of file
+
+    // Framebuffer sized streaming texture that the renderer scales to the window
+    SDL_Texture* texture = nullptr;
+    Display uploaded;
+    bool has_upload = false;
+
+    Beeper beeper;
+
+    void upload(const Display& display);
+};
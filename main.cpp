@@ -1,27 +1,167 @@
 #include <iostream>
+#include <memory>
 
 #include "engine/engine.h"
+#include "engine/headless.h"
+#ifdef CHIP8_SDL
+#include "engine/window.h"
+#endif
 
 int main(int argc, char** argv) {
     std::string filepath;
-    int cycles = 10;
+    int cpu_hz = 600;
     float fps = 60.0;
-    if (argc < 2) {
+    bool headless = false;
+    [[maybe_unused]] bool vsync = false;  // Only read by the SDL window
+    bool stats = false;
+    bool turbo = false;
+    bool threaded = false;
+    int turbo_skip = 0;
+    long frames = 0;
+    std::string record_path;
+    std::string capture_path;
+    std::string replay_path;
+    std::string load_state_path;
+    std::string save_state_path;
+    std::string keys;
+    auto seed = prng::default_seed;
+    auto mode = ExecutionMode::Interpreter;
+    auto variant_set = false;
+    auto variant = Variant::Chip8;
+
+    for (auto i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frames = std::stol(argv[++i]);
+        } else if (arg == "--hz" && i + 1 < argc) {
+            cpu_hz = std::stoi(argv[++i]);
+        } else if (arg == "--fps" && i + 1 < argc) {
+            fps = std::stof(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--record" && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (arg == "--capture" && i + 1 < argc) {
+            capture_path = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replay_path = argv[++i];
+            headless = true;
+        } else if (arg == "--load-state" && i + 1 < argc) {
+            load_state_path = argv[++i];
+        } else if (arg == "--save-state" && i + 1 < argc) {
+            save_state_path = argv[++i];
+        } else if (arg == "--keys" && i + 1 < argc) {
+            keys = argv[++i];
+        } else if (arg == "--turbo") {
+            turbo = true;
+        } else if (arg == "--turbo-skip" && i + 1 < argc) {
+            turbo = true;
+            turbo_skip = std::stoi(argv[++i]);
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--threaded") {
+            threaded = true;
+        } else if (arg == "--variant" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (!parse_variant(name, variant)) {
+                std::cerr << "Unknown variant: " << name << std::endl;
+                return EXIT_FAILURE;
+            }
+            variant_set = true;
+        } else if (arg == "--vsync") {
+            vsync = true;
+        } else if (arg == "--engine" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "blocks") {
+                mode = ExecutionMode::Blocks;
+            } else if (name == "jit") {
+                mode = ExecutionMode::Jit;
+            } else if (name == "static") {
+                mode = ExecutionMode::Static;
+            } else if (name != "interpreter") {
+                std::cerr << "Unknown execution engine: " << name << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else {
+            filepath = arg;
+        }
+    }
+
+    if (filepath.empty()) {
         std::cout << "No rom provided, loading TETRIS..." << std::endl;
         filepath = "roms/TETRIS";
+    }
+    if (!variant_set) {
+        variant = guess_variant(filepath);
+    }
+    if (!load_state_path.empty() && (!record_path.empty() || !replay_path.empty())) {
+        std::cerr << "Movies start from the rom, not from a loaded state" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+#ifndef CHIP8_SDL
+    headless = true;
+#endif
+#ifndef CHIP8_PROFILE
+    if (stats) {
+        std::cerr << "Statistics need a build with -DCHIP8_PROFILE=ON" << std::endl;
+    }
+#endif
+
+    std::unique_ptr<Frontend> frontend;
+    if (headless) {
+        frontend = std::make_unique<Headless>(frames);
     } else {
-        filepath = argv[1];
+#ifdef CHIP8_SDL
+        Keymap keymap;
+        if (!keys.empty()) {
+            try {
+                keymap = Keymap::parse(keys);
+            } catch (const std::exception& e) {
+                std::cerr << e.what();
+                return EXIT_FAILURE;
+            }
+        }
+        frontend = std::make_unique<Window>(vsync, keymap);
+#endif
     }
 
-    Engine engine;
+    Engine engine(std::move(frontend));
 
-    if (!engine.init(cycles, fps)) {
+    if (!engine.init(cpu_hz, fps)) {
         std::cerr << "Failed to initialize engine" << std::endl;
         return EXIT_FAILURE;
     }
 
+    engine.set_execution_mode(mode);
+    engine.seed(seed);
+    engine.show_stats(stats);
+    engine.set_turbo(turbo, turbo_skip);
+    engine.set_threaded(threaded);
+    engine.set_variant(variant);
+    if (!replay_path.empty()) {
+        engine.replay(replay_path);
+    } else if (!record_path.empty()) {
+        engine.record(record_path);
+    }
+    if (!capture_path.empty()) {
+        engine.capture(capture_path);
+    }
     engine.load_rom(filepath);
+    if (!load_state_path.empty()) {
+        try {
+            engine.load_state(load_state_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what();
+            return EXIT_FAILURE;
+        }
+    }
+    if (!save_state_path.empty()) {
+        engine.save_state(save_state_path);
+    }
     engine.start();
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
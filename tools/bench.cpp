@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "core/chip8.h"
+#include "core/memory.h"
+#include "core/rom.h"
+#include "core/snapshot.h"
+#include "engine/capture.h"
+#include "engine/engine.h"
+#include "engine/headless.h"
+
+namespace {
+
+struct Options {
+    std::string roms = "roms";
+    std::string filter;
+    std::string out;
+    int repeat = 5;
+};
+
+struct Result {
+    std::string name;
+    double median;  // ns per operation
+    double min;
+    long iterations;
+};
+
+// Times a body that performs the given number of operations, once per repetition after a
+// warm-up run, and reports the cost of one operation.
+Result measure(const std::string& name, long iterations, int repeat, const std::function<void(long)>& body) {
+    body(std::max(1L, iterations / 10));
+
+    std::vector<double> samples;
+    for (auto i = 0; i < repeat; i++) {
+        auto start = std::chrono::steady_clock::now();
+        body(iterations);
+        auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        samples.push_back(ns / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+    return {name, samples[samples.size() / 2], samples.front(), iterations};
+}
+
+// A program that runs one kind of instruction over and over. The prologue runs once, then the
+// loop body repeats the instruction produced for each address and jumps back. Subroutines
+// follow the loop.
+struct Program {
+    std::string name;
+    std::vector<uint16_t> prologue;
+    std::function<uint16_t(int address)> body;
+    std::vector<uint16_t> subroutine;
+};
+
+constexpr int body_length = 240;
+
+std::string write_rom(const Program& program) {
+    std::vector<uint16_t> code = program.prologue;
+    auto loop = Memory::offset + 2 * static_cast<int>(code.size());
+    for (auto i = 0; i < body_length; i++) {
+        code.push_back(program.body(loop + 2 * i));
+    }
+    code.push_back(0x1000 | loop);
+    code.insert(code.end(), program.subroutine.begin(), program.subroutine.end());
+
+    auto path = (std::filesystem::temp_directory_path() / ("chip8_bench_" + program.name + ".ch8")).string();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    for (auto opcode : code) {
+        file.put(static_cast<char>(opcode >> 8));
+        file.put(static_cast<char>(opcode & 0xFF));
+    }
+    return path;
+}
+
+// Address of the subroutine of a program without prologue
+constexpr int subroutine = Memory::offset + 2 * (body_length + 1);
+
+auto repeat(uint16_t opcode) {
+    return [opcode](int) { return opcode; };
+}
+
+// One program per handler. V0 and V1 are 0 and I points at the font unless the prologue says
+// otherwise, so skips on V0 are taken and sprites come from the font.
+std::vector<Program> programs() {
+    return {
+        {"nop", {}, repeat(0x0000), {}},
+        {"cls", {}, repeat(0x00E0), {}},
+        {"jmp", {}, [](int address) { return static_cast<uint16_t>(0x1000 | (address + 2)); }, {}},
+        {"call_ret", {}, repeat(0x2000 | subroutine), {0x00EE}},
+        {"se_byte_taken", {}, repeat(0x3000), {}},
+        {"se_byte", {}, repeat(0x3001), {}},
+        {"sne_byte", {}, repeat(0x4000), {}},
+        {"se_reg", {}, repeat(0x5010), {}},
+        {"ld_byte", {}, repeat(0x6012), {}},
+        {"add_byte", {}, repeat(0x7001), {}},
+        {"ld_reg", {}, repeat(0x8010), {}},
+        {"or", {}, repeat(0x8011), {}},
+        {"and", {}, repeat(0x8012), {}},
+        {"xor", {}, repeat(0x8013), {}},
+        {"add_reg", {}, repeat(0x8014), {}},
+        {"sub", {}, repeat(0x8015), {}},
+        {"shr", {}, repeat(0x8016), {}},
+        {"subn", {}, repeat(0x8017), {}},
+        {"shl", {}, repeat(0x801E), {}},
+        {"sne", {}, repeat(0x9010), {}},
+        {"ld_i", {}, repeat(0xA300), {}},
+        {"jp_reg", {}, [](int address) { return static_cast<uint16_t>(0xB000 | (address + 2)); }, {}},
+        {"rnd", {}, repeat(0xC0FF), {}},
+        {"drw_1", {}, repeat(0xD011), {}},
+        {"drw_5", {}, repeat(0xD015), {}},
+        {"drw_8", {}, repeat(0xD018), {}},
+        {"drw_15", {}, repeat(0xD01F), {}},
+        {"skp", {}, repeat(0xE09E), {}},
+        {"sknp", {}, repeat(0xE0A1), {}},
+        {"ld_delay_timer", {}, repeat(0xF007), {}},
+        {"ld_timer_wait", {}, repeat(0xF00A), {}},
+        {"ld_delay_timer_set", {}, repeat(0xF015), {}},
+        {"ld_sound_timer_set", {}, repeat(0xF018), {}},
+        {"add_i_reg", {}, repeat(0xF01E), {}},
+        {"set_i_reg", {}, repeat(0xF029), {}},
+        {"bcd", {0xAE00}, repeat(0xF033), {}},
+        // Moves I past the 15 bytes it writes, so every 16th instruction resets I
+        {"cpy_regs_to_mem", {}, [](int address) { return static_cast<uint16_t>(address % 32 == 0 ? 0xAE00 : 0xFF55); }, {}},
+        {"cpy_mem_to_regs", {}, repeat(0xFF65), {}},
+    };
+}
+
+// Frontend that expands the framebuffer into ARGB pixels in memory, like the window does
+// before uploading its texture.
+class Offscreen : public Frontend {
+   public:
+    bool init(int, int, std::string) override {
+        running = true;
+        return true;
+    }
+
+    void poll_events(std::vector<KeyEvent>&) override {}
+
+    void present(const Display& display) override {
+        display.expand(pixels.data(), Display::m_width, palette);
+    }
+
+    bool realtime() const override {
+        return false;
+    }
+
+   private:
+    std::vector<uint32_t> pixels = std::vector<uint32_t>(Display::m_width * Display::m_height);
+};
+
+const char* mode_name(ExecutionMode mode) {
+    switch (mode) {
+        case ExecutionMode::Blocks:
+            return "blocks";
+        case ExecutionMode::Jit:
+            return "jit";
+        case ExecutionMode::Static:
+            return "static";
+        default:
+            return "interpreter";
+    }
+}
+
+void write_json(std::ostream& out, const std::vector<Result>& results) {
+    out << "{\n  \"unit\": \"ns/op\",\n  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        char line[256];
+        std::snprintf(line, sizeof(line), "    {\"name\": \"%s\", \"median\": %.3f, \"min\": %.3f, \"iterations\": %ld}%s\n",
+                      r.name.c_str(), r.median, r.min, r.iterations, i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+}
+
+}  // namespace
+
+// Runs the microbenchmarks and prints the cost of one operation of each as JSON.
+int main(int argc, char** argv) {
+    Options options;
+    for (auto i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--roms" && i + 1 < argc) {
+            options.roms = argv[++i];
+        } else if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            options.repeat = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--out" && i + 1 < argc) {
+            options.out = argv[++i];
+        } else {
+            std::cerr << "Usage: chip8_bench [--roms DIR] [--filter TEXT] [--repeat N] [--out FILE]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<Result> results;
+    auto run = [&](const std::string& name, long iterations, const std::function<void(long)>& body) {
+        if (name.find(options.filter) == std::string::npos) {
+            return;
+        }
+        results.push_back(measure(name, iterations, options.repeat, body));
+        std::cerr << name << ": " << results.back().median << " ns" << std::endl;
+    };
+
+    try {
+        // Cost of each handler in the interpreter. Wait loops run every instruction, so programs
+        // like ld_timer_wait, which repeats itself without a key, measure the handler.
+        for (auto& program : programs()) {
+            auto path = write_rom(program);
+            Chip8 chip8;
+            chip8.set_idle_skipping(false);
+            run("opcode/" + program.name, 1 << 20, [&](long n) {
+                chip8.reset();
+                chip8.load_rom(path);
+                chip8.run(static_cast<int>(n));
+            });
+            std::filesystem::remove(path);
+        }
+
+        // Sustained throughput on real games, 10 instructions and one timer tick per frame. All of
+        // them run, also in the wait loops of the games.
+        for (auto rom : {"TETRIS", "INVADERS"}) {
+            auto path = options.roms + "/" + rom;
+            for (auto mode : {ExecutionMode::Interpreter, ExecutionMode::Blocks, ExecutionMode::Jit,
+                              ExecutionMode::Static}) {
+                Chip8 chip8;
+                chip8.set_execution_mode(mode);
+                chip8.set_idle_skipping(false);
+                run(std::string("tick/") + rom + "/" + mode_name(mode), 1 << 20, [&](long n) {
+                    chip8.reset();
+                    chip8.load_rom(path);
+                    for (long i = 0; i < n; i += 10) {
+                        chip8.run_frame({10, 1});
+                    }
+                });
+            }
+
+            Memory memory;
+            run(std::string("load_rom/") + rom, 2000, [&](long n) {
+                for (long i = 0; i < n; i++) {
+                    memory.load_rom(path);
+                }
+            });
+
+            RomCache cache;
+            run(std::string("load_rom/") + rom + "/cached", 1 << 16, [&](long n) {
+                for (long i = 0; i < n; i++) {
+                    memory.load_rom(*cache.load(path));
+                }
+            });
+        }
+
+        // Saving and restoring the state of a running game in memory, and restoring it from a
+        // mapped snapshot file, which also compares memory to keep the decoded instructions
+        auto snapshot_path = (std::filesystem::temp_directory_path() / "chip8_bench.c8s").string();
+        {
+            Chip8 chip8;
+            chip8.reset();
+            chip8.load_rom(options.roms + "/TETRIS");
+            chip8.run(1000);
+            MachineState state;
+            run("snapshot/save", 1 << 20, [&](long n) {
+                for (long i = 0; i < n; i++) {
+                    chip8.save(state);
+                }
+            });
+            run("snapshot/load", 1 << 20, [&](long n) {
+                for (long i = 0; i < n; i++) {
+                    chip8.load(state);
+                }
+            });
+
+            Snapshot::save(snapshot_path, chip8);
+            Snapshot snapshot(snapshot_path);
+            run("snapshot/restore", 1 << 20, [&](long n) {
+                for (long i = 0; i < n; i++) {
+                    snapshot.restore(chip8);
+                }
+            });
+            run("snapshot/map", 1 << 12, [&](long n) {
+                for (long i = 0; i < n; i++) {
+                    Snapshot(snapshot_path).restore(chip8);
+                }
+            });
+        }
+        std::filesystem::remove(snapshot_path);
+
+        // Presenting a frame, without output and into an ARGB buffer
+        Engine headless(std::make_unique<Headless>());
+        Engine offscreen(std::make_unique<Offscreen>());
+        for (auto engine : {&headless, &offscreen}) {
+            if (!engine->init()) {
+                throw std::runtime_error("Failed to initialize engine\n");
+            }
+            engine->load_rom(options.roms + "/TETRIS");
+            for (auto i = 0; i < 600; i++) {
+                engine->update();
+            }
+        }
+        run("draw/headless", 1 << 20, [&](long n) {
+            for (long i = 0; i < n; i++) {
+                headless.draw();
+            }
+        });
+        run("draw/argb", 1 << 16, [&](long n) {
+            for (long i = 0; i < n; i++) {
+                offscreen.draw();
+            }
+        });
+
+        // Capturing a frame that did not change, the cost to the emulation of most frames
+        auto capture_path = (std::filesystem::temp_directory_path() / "chip8_bench.c8v").string();
+        {
+            Chip8 chip8;
+            chip8.reset();
+            chip8.load_rom(options.roms + "/TETRIS");
+            chip8.run(1000);
+            Capture capture(capture_path, 60.0);
+            run("capture/unchanged", 1 << 20, [&](long n) {
+                for (long i = 0; i < n; i++) {
+                    capture.push(chip8.get_display());
+                }
+            });
+        }
+        std::filesystem::remove(capture_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what();
+        return EXIT_FAILURE;
+    }
+
+    if (options.out.empty()) {
+        write_json(std::cout, results);
+    } else {
+        std::ofstream file(options.out);
+        write_json(file, results);
+    }
+    return EXIT_SUCCESS;
+}
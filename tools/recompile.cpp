@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "core/memory.h"
+#include "core/rom.h"
+#include "core/static_executor.h"
+
+// Compiles a rom ahead of time into a C++ file with one function per basic block, which
+// StaticExecutor runs once the file is linked into a binary. See README.md.
+
+namespace {
+
+// Mnemonics of the operations, indexed by Op
+const char* const names[op_count] = {
+    "nop", "cls", "ret", "jmp", "call", "se_byte", "sne_byte", "se_reg", "ld_byte", "add_byte",
+    "ld_reg", "or", "and", "xor", "add_reg", "sub", "shr", "subn", "shl", "sne", "ld", "jp_reg",
+    "rnd", "drw", "skp", "sknp", "ld_delay_timer", "ld_timer_wait", "ld_delay_timer_set",
+    "ld_sound_timer_set", "add_i_reg", "set_i_reg", "bcd", "cpy_regs_to_mem", "cpy_mem_to_regs",
+    "scroll_down", "scroll_right", "scroll_left", "halt", "lores", "hires", "set_i_big",
+    "save_flags", "load_flags", "scroll_up", "save_range", "load_range", "ld_long", "plane",
+    "audio", "ld_pitch", "exit",
+};
+
+const char* variant_name(Variant variant) {
+    switch (variant) {
+        case Variant::SuperChip:
+            return "Variant::SuperChip";
+        case Variant::XoChip:
+            return "Variant::XoChip";
+        default:
+            return "Variant::Chip8";
+    }
+}
+
+std::string hex(int value, int digits) {
+    char text[16];
+    std::snprintf(text, sizeof(text), "0x%0*X", digits, value);
+    return text;
+}
+
+// The rom as it is loaded into memory, with the instructions decoded for one variant.
+class Program {
+   public:
+    Program(const Rom& rom, Variant variant) : image(rom.data()), variant(variant) {
+        // Blocks live in the first 4 KB like the blocks of the other executors
+        end = std::min(Memory::offset + static_cast<int>(image.size()), 0x1000);
+    }
+
+    // Returns whether a whole instruction at the address belongs to the rom.
+    bool contains(int address) const {
+        return address >= Memory::offset && address + 1 < end;
+    }
+
+    int opcode(int address) const {
+        return image[address - Memory::offset] << 8 | image[address + 1 - Memory::offset];
+    }
+
+    Instruction decode(int address) const {
+        return StaticCode::decode(opcode(address), variant);
+    }
+
+    // Returns the number of bytes a taken skip at the address skips.
+    int skip_size(int address) const {
+        return contains(address + 2) && decode(address + 2).op == Op::ld_long ? 6 : 4;
+    }
+
+    const std::vector<uint8_t>& image;
+    Variant variant;
+    int end;
+};
+
+// Decodes a block like BlockExecutor: up to the first instruction that ends it.
+int block_length(const Program& program, int start) {
+    auto length = 0;
+    for (auto address = start; program.contains(address); address += 2) {
+        length++;
+        if (ends_block(program.decode(address).op) || length == StaticExecutor::max_length) {
+            break;
+        }
+    }
+    return length;
+}
+
+// Follows the program from its start through jumps, calls, returns, skips and blocking
+// instructions. Computed jumps are followed to every even offset of V0. Returns the start
+// address and length of each block.
+std::map<int, int> trace(const Program& program) {
+    std::map<int, int> blocks;
+    std::vector<int> pending = {Memory::offset};
+    auto follow = [&](int address) {
+        if (program.contains(address) && blocks.count(address) == 0) {
+            pending.push_back(address);
+        }
+    };
+
+    while (!pending.empty()) {
+        auto start = pending.back();
+        pending.pop_back();
+        if (blocks.count(start) != 0) {
+            continue;
+        }
+        auto length = block_length(program, start);
+        blocks[start] = length;
+
+        for (auto address = start; address < start + 2 * length; address += 2) {
+            auto ins = program.decode(address);
+            auto next = address + 2;
+            switch (ins.op) {
+                case Op::jmp:
+                    follow(ins.nnn);
+                    break;
+                case Op::call:
+                    follow(ins.nnn);
+                    follow(next);
+                    break;
+                case Op::jp_reg:
+                    for (auto offset = 0; offset < 0x100; offset += 2) {
+                        follow(ins.nnn + offset);
+                    }
+                    break;
+                case Op::ld_timer_wait:
+                case Op::halt:
+                    follow(address);
+                    follow(next);
+                    break;
+                case Op::ld_long:
+                    follow(next + 2);
+                    break;
+                case Op::ret:
+                    break;
+                default:
+                    if (is_skip(ins.op)) {
+                        follow(address + program.skip_size(address));
+                    } else if (ends_block(ins.op)) {
+                        follow(next);
+                    }
+                    break;
+            }
+        }
+        follow(start + 2 * length);
+    }
+    return blocks;
+}
+
+// Emits one block as a function on the machine state. Register, jump and timer instructions
+// are written out, all others call their interpreter handler.
+// Blocks that start inside other blocks share the declarations of their handler instructions.
+void emit_block(std::ostream& out, const Program& program, int start, int length, std::ostream& handlers,
+                std::set<int>& declared) {
+    out << "int block_" << hex(start, 4).substr(2) << "(Chip8& chip8) {\n";
+    out << "    auto& s = StaticCode::state(chip8);\n";
+
+    // XO-CHIP skips look at the next instruction at runtime, in the handler
+    auto inline_skips = program.variant != Variant::XoChip;
+    auto reg = [](int x) { return "s.regs[" + hex(x, 1) + "]"; };
+
+    for (auto count = 1; count <= length; count++) {
+        auto address = start + 2 * (count - 1);
+        auto ins = program.decode(address);
+        auto next = hex(address + 2, 4);
+        auto leave = "return " + std::to_string(count) + ";";
+        auto x = reg(ins.x);
+        auto y = reg(ins.y);
+        auto kk = hex(ins.kk, 2);
+
+        out << "    // " << hex(address, 4).substr(2) << ": " << hex(program.opcode(address), 4).substr(2) << " "
+            << names[static_cast<int>(ins.op)] << "\n";
+        switch (ins.op) {
+            case Op::nop:
+                break;
+            case Op::ret:
+                out << "    s.pc = DefaultAccess::at(s.stack, --s.sp);\n    " << leave << "\n";
+                break;
+            case Op::jmp:
+                out << "    s.pc = " << hex(ins.nnn, 4) << ";\n    " << leave << "\n";
+                break;
+            case Op::call:
+                out << "    DefaultAccess::at(s.stack, s.sp++) = " << next << ";\n";
+                out << "    s.pc = " << hex(ins.nnn, 4) << ";\n    " << leave << "\n";
+                break;
+            case Op::jp_reg:
+                out << "    s.pc = " << hex(ins.nnn, 4) << " + s.regs[0x0];\n    " << leave << "\n";
+                break;
+            case Op::ld_byte:
+                out << "    " << x << " = " << kk << ";\n";
+                break;
+            case Op::add_byte:
+                out << "    " << x << " += " << kk << ";\n";
+                break;
+            case Op::ld_reg:
+                out << "    " << x << " = " << y << ";\n";
+                break;
+            case Op::fn_or:
+                out << "    " << x << " |= " << y << ";\n";
+                break;
+            case Op::fn_and:
+                out << "    " << x << " &= " << y << ";\n";
+                break;
+            case Op::fn_xor:
+                out << "    " << x << " ^= " << y << ";\n";
+                break;
+            case Op::add_reg:
+                out << "    s.regs[0xF] = " << x << " + " << y << " > 0xFF;\n";
+                out << "    " << x << " += " << y << ";\n";
+                break;
+            case Op::sub:
+                out << "    s.regs[0xF] = " << x << " > " << y << ";\n";
+                out << "    " << x << " -= " << y << ";\n";
+                break;
+            case Op::shr:
+                out << "    s.regs[0xF] = " << x << " & 1;\n";
+                out << "    " << x << " >>= 1;\n";
+                break;
+            case Op::subn:
+                out << "    s.regs[0xF] = " << y << " > " << x << ";\n";
+                out << "    " << x << " = " << y << " - " << x << ";\n";
+                break;
+            case Op::shl:
+                out << "    s.regs[0xF] = (" << x << " >> 7) & 1;\n";
+                out << "    " << x << " <<= 1;\n";
+                break;
+            case Op::ld:
+                out << "    s.I = " << hex(ins.nnn, 4) << ";\n";
+                break;
+            case Op::rnd:
+                out << "    " << x << " = prng::next(s.rng) & " << kk << ";\n";
+                break;
+            case Op::ld_delay_timer:
+                out << "    " << x << " = s.delay_timer;\n";
+                break;
+            case Op::ld_delay_timer_set:
+                out << "    s.delay_timer = " << x << ";\n";
+                break;
+            case Op::ld_sound_timer_set:
+                out << "    s.sound_timer = " << x << ";\n";
+                break;
+            case Op::add_i_reg:
+                out << "    s.I += " << x << ";\n";
+                break;
+            case Op::set_i_reg:
+                out << "    s.I = " << x << " * 5;\n";
+                break;
+            case Op::se_byte:
+            case Op::sne_byte:
+            case Op::se_reg:
+            case Op::sne:
+                if (inline_skips) {
+                    auto equal = ins.op == Op::se_byte || ins.op == Op::se_reg;
+                    auto operand = ins.op == Op::se_byte || ins.op == Op::sne_byte ? kk : y;
+                    out << "    if (" << x << (equal ? " == " : " != ") << operand << ") {\n";
+                    out << "        s.pc = " << hex(address + 4, 4) << ";\n        " << leave << "\n    }\n";
+                    break;
+                }
+                [[fallthrough]];
+            default: {
+                auto name = "i_" + hex(address, 4).substr(2);
+                if (declared.insert(address).second) {
+                    handlers << "const Instruction " << name << " = StaticCode::decode("
+                             << hex(program.opcode(address), 4) << ", " << variant_name(program.variant) << ");\n";
+                }
+                out << "    s.pc = " << next << ";\n";
+                out << "    StaticCode::execute(chip8, " << name << ");\n";
+                if (ends_block(ins.op)) {
+                    out << "    " << leave << "\n";
+                } else if (is_skip(ins.op)) {
+                    out << "    if (s.pc != " << next << ") {\n        " << leave << "\n    }\n";
+                }
+                break;
+            }
+        }
+    }
+
+    auto last = program.decode(start + 2 * (length - 1));
+    if (!ends_block(last.op)) {
+        out << "    s.pc = " << hex(start + 2 * length, 4) << ";\n";
+        out << "    return " << length << ";\n";
+    }
+    out << "}\n\n";
+}
+
+// Turns a file name into an identifier for the comment and the program name.
+std::string program_name(const std::string& path) {
+    auto name = path.substr(path.find_last_of("/\\") + 1);
+    name = name.substr(0, name.find('.'));
+    for (auto& c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) {
+            c = '_';
+        }
+    }
+    return name;
+}
+
+void emit(std::ostream& out, const Program& program, const std::string& name, const std::map<int, int>& blocks) {
+    std::ostringstream code;
+    std::ostringstream handlers;
+    std::set<int> declared;
+    for (auto& block : blocks) {
+        emit_block(code, program, block.first, block.second, handlers, declared);
+    }
+
+    out << "// Generated by chip8_recompile from " << name << ". Do not edit.\n\n";
+    out << "#include \"core/random.h\"\n";
+    out << "#include \"core/static_executor.h\"\n\n";
+    out << "namespace {\n\n";
+
+    out << "const uint8_t image[] = {";
+    for (std::size_t i = 0; i < program.image.size(); i++) {
+        out << (i % 16 == 0 ? "\n    " : " ") << hex(program.image[i], 2) << ",";
+    }
+    out << "\n};\n\n";
+
+    out << "// Instructions that run through their interpreter handler\n";
+    out << handlers.str() << "\n";
+    out << code.str();
+
+    out << "const StaticBlock blocks[] = {\n";
+    for (auto& block : blocks) {
+        auto suffix = hex(block.first, 4).substr(2);
+        out << "    {" << hex(block.first, 4) << ", " << block.second << ", &block_" << suffix << "},\n";
+    }
+    out << "};\n\n";
+
+    out << "const StaticProgram program = {\"" << name << "\", " << variant_name(program.variant)
+        << ", image, sizeof(image), blocks, sizeof(blocks) / sizeof(blocks[0])};\n\n";
+    out << "const bool registered = StaticExecutor::add(program);\n\n";
+    out << "}  // namespace\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string rom_path;
+    std::string out_path;
+    std::string name;
+    auto variant_set = false;
+    auto variant = Variant::Chip8;
+
+    for (auto i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--variant" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (!parse_variant(value, variant)) {
+                std::cerr << "Unknown variant: " << value << std::endl;
+                return EXIT_FAILURE;
+            }
+            variant_set = true;
+        } else if (arg == "--name" && i + 1 < argc) {
+            name = argv[++i];
+        } else if (rom_path.empty()) {
+            rom_path = arg;
+        } else {
+            out_path = arg;
+        }
+    }
+
+    if (rom_path.empty() || out_path.empty()) {
+        std::cerr << "Usage: chip8_recompile [--variant NAME] [--name NAME] rom out.cpp" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!variant_set) {
+        variant = guess_variant(rom_path);
+    }
+    if (name.empty()) {
+        name = program_name(rom_path);
+    }
+
+    try {
+        auto rom = Rom::from_file(rom_path);
+        Program program(rom, variant);
+        auto blocks = trace(program);
+
+        std::ofstream out(out_path, std::ios::trunc);
+        emit(out, program, name, blocks);
+        if (!out.good()) {
+            throw std::runtime_error("Could not write " + out_path + "!\n");
+        }
+
+        auto instructions = 0;
+        for (auto& block : blocks) {
+            instructions += block.second;
+        }
+        std::printf("%s: %zu blocks, %d instructions\n", name.c_str(), blocks.size(), instructions);
+    } catch (const std::exception& e) {
+        std::cerr << e.what();
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/batch.h"
+#include "core/chip8.h"
+#include "core/random.h"
+#include "engine/runner.h"
+
+// Runs all instances of each rom in lockstep on one Batch. To verify the batch, every lane gets
+// its own seed and random key presses, and after every frame its screen is compared with a
+// Chip8 that runs alone with the same input.
+int run_lockstep(const Runner::Job& base, int instances, bool verify, const std::vector<std::string>& roms) {
+    uint64_t cycles = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    // Batch runs the original instruction set only
+    for (auto& rom : roms) {
+        if (guess_variant(rom) != Variant::Chip8) {
+            std::cerr << rom << ": SUPER-CHIP and XO-CHIP roms cannot run in lockstep" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (auto& rom : roms) {
+        auto rom_start = std::chrono::steady_clock::now();
+        Batch batch(instances);
+        std::vector<std::unique_ptr<Chip8>> singles;
+        std::vector<uint64_t> input;
+        try {
+            batch.load_rom(rom);
+            for (auto i = 0; verify && i < instances; i++) {
+                batch.seed(i, prng::default_seed + i);
+                singles.push_back(std::make_unique<Chip8>());
+                singles[i]->seed(prng::default_seed + i);
+                singles[i]->set_execution_mode(base.mode);
+                singles[i]->reset();
+                singles[i]->load_rom(rom);
+                input.push_back(i);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << rom << ": " << e.what();
+            return EXIT_FAILURE;
+        }
+
+        uint64_t rom_cycles = 0;
+        Clock clock(base.cpu_hz, base.fps);
+        for (auto i = 0; i < base.frames; i++) {
+            auto frame = clock.next_frame();
+            for (std::size_t lane = 0; lane < singles.size(); lane++) {
+                // Presses or releases a key in about every eighth frame
+                auto random = prng::next(input[lane]);
+                if (random % 8 == 0) {
+                    auto key = (random >> 8) & 0xF;
+                    auto pressed = (random >> 12) & 1;
+                    batch.set_key(lane, key, pressed);
+                    singles[lane]->set_key(key, pressed);
+                }
+            }
+            batch.run_frame(frame);
+            rom_cycles += frame.cycles;
+            for (std::size_t lane = 0; lane < singles.size(); lane++) {
+                singles[lane]->run_frame(frame);
+                if (batch.get_display(lane) != singles[lane]->get_display()) {
+                    std::cerr << rom << " #" << lane << ": lockstep differs from a single machine in frame " << i
+                              << std::endl;
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+        auto wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - rom_start).count();
+
+        for (auto i = 0; i < instances; i++) {
+            std::printf("%s,%d,%016llx,%llu,%.3f\n", rom.c_str(), i,
+                        static_cast<unsigned long long>(batch.get_display(i).hash()),
+                        static_cast<unsigned long long>(rom_cycles), wall_ms);
+        }
+        cycles += rom_cycles * instances;
+    }
+
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("# %zu machines in lockstep, %llu cycles in %.3f s (%.1f MIPS)\n", roms.size() * instances,
+                static_cast<unsigned long long>(cycles), wall, cycles / wall / 1e6);
+    return EXIT_SUCCESS;
+}
+
+// Runs every given rom on a number of machines in parallel and prints one line per machine:
+// rom, instance, framebuffer hash, cycles and wall time. A summary line follows.
+int main(int argc, char** argv) {
+    Runner::Job base;
+    int instances = 1;
+    int threads = 0;
+    bool lockstep = false;
+    bool verify = false;
+    std::vector<std::string> roms;
+
+    for (auto i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            base.frames = std::stol(argv[++i]);
+        } else if (arg == "--hz" && i + 1 < argc) {
+            base.cpu_hz = std::stoi(argv[++i]);
+        } else if (arg == "--instances" && i + 1 < argc) {
+            instances = std::stoi(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::stoi(argv[++i]);
+        } else if (arg == "--lockstep") {
+            lockstep = true;
+        } else if (arg == "--verify") {
+            verify = true;
+        } else if (arg == "--engine" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "blocks") {
+                base.mode = ExecutionMode::Blocks;
+            } else if (name == "jit") {
+                base.mode = ExecutionMode::Jit;
+            } else if (name == "static") {
+                base.mode = ExecutionMode::Static;
+            } else if (name != "interpreter") {
+                std::cerr << "Unknown execution engine: " << name << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else {
+            roms.push_back(arg);
+        }
+    }
+
+    if (roms.empty()) {
+        std::cerr << "Usage: chip8_run [--frames N] [--hz N] [--instances N] [--threads N] [--engine NAME] [--lockstep [--verify]] rom..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (lockstep) {
+        return run_lockstep(base, instances, verify, roms);
+    }
+
+    std::vector<Runner::Job> jobs;
+    for (auto& rom : roms) {
+        for (auto i = 0; i < instances; i++) {
+            auto job = base;
+            job.rom = rom;
+            job.variant = guess_variant(rom);
+            jobs.push_back(job);
+        }
+    }
+
+    Runner runner(threads);
+    auto start = std::chrono::steady_clock::now();
+    auto results = runner.run(jobs);
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t cycles = 0;
+    auto failed = 0;
+    for (std::size_t i = 0; i < jobs.size(); i++) {
+        auto& result = results[i];
+        if (!result.ok) {
+            failed++;
+            std::cerr << jobs[i].rom << " #" << i % instances << ": " << result.error;
+            continue;
+        }
+        cycles += result.cycles;
+        std::printf("%s,%zu,%016llx,%llu,%.3f\n", jobs[i].rom.c_str(), i % instances,
+                    static_cast<unsigned long long>(result.framebuffer_hash),
+                    static_cast<unsigned long long>(result.cycles), result.wall_ms);
+    }
+
+    std::printf("# %zu machines on %d threads, %llu cycles in %.3f s (%.1f MIPS), %d failed\n", jobs.size(),
+                runner.get_threads(), static_cast<unsigned long long>(cycles), wall, cycles / wall / 1e6, failed);
+
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}